@@ -0,0 +1,341 @@
+// Benchmark harness (built and run by `make bench`).
+// Times lexing, parsing, elaboration and ticks for a set of workloads
+// based on the sncomputer and prints the results as JSON.
+// Lexing and parsing cover the workload and every file it imports
+// (elaboration includes the time to lex and parse the imports too).
+// Must be run from the sncomputer directory (for its imports).
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <functional>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "errorHandler.hpp"
+#include "interpreter.hpp"
+#include "netlist.hpp"
+
+using namespace std;
+using namespace snowlang;
+
+// number of heap allocations so far (counted by the operator new below)
+static atomic<size_t> allocations{0};
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *memory = malloc(size ? size : 1))
+        return memory;
+    throw bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+namespace
+{
+    // every measurement is repeated until it took at least this long
+    const double MIN_SECONDS = 0.25;
+
+    struct Workload
+    {
+        string name;
+        string text;
+    };
+
+    struct SimModeName
+    {
+        SimMode mode;
+        string name;
+    };
+
+    const SimModeName SIM_MODES[] = {
+        {SM_SWEEP, "sweep"},
+        {SM_EVENT, "event"},
+        {SM_WORD, "word"},
+        {SM_BATCH, "batch"},
+        {SM_JIT, "jit"},
+        {SM_SETTLE, "settle"}};
+
+    double now()
+    {
+        return chrono::duration<double>(
+                   chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // average time of a run of the given function in seconds
+    double timeRepeated(const function<void()> &run)
+    {
+        size_t runs = 0;
+        double start = now(), elapsed = 0;
+        do
+        {
+            run();
+            runs++;
+            elapsed = now() - start;
+        } while (elapsed < MIN_SECONDS);
+        return elapsed / runs;
+    }
+
+    string readFile(const string &filename)
+    {
+        fstream file;
+        file.open(filename, ios::in);
+        if (!file)
+        {
+            cout << "File '" << filename << "' does not exist." << endl;
+            exit(1);
+        }
+        stringstream buf;
+        buf << file.rdbuf();
+        return buf.str();
+    }
+
+    // replaces the first `from` in `text` with `to`
+    void replace(string &text, const string &from, const string &to)
+    {
+        size_t start = text.find(from);
+        if (start == string::npos)
+        {
+            cerr << "Can't find '" << from << "' to replace." << endl;
+            exit(1);
+        }
+        text.replace(start, from.size(), to);
+    }
+
+    // main.sno with the given number of bits (and stack pointer bits)
+    string mainWithBits(const string &mainText, const string &aluText,
+                        int bits)
+    {
+        string result = mainText;
+        if (bits == 8)
+            return result;
+        replace(result, "    bits = 8;", "    bits = " + to_string(bits) + ";");
+        replace(result, "    stackp_bits = 8;",
+                "    stackp_bits = " + to_string(bits) + ";");
+        // the ALU's random number generator always has 8 bits, so the
+        // ALU is included with only the bits both have connected
+        string alu = aluText;
+        replace(alu, "    con prng.bits prng_out;",
+                "    for i in (0, bits - 1)\n"
+                "    {\n"
+                "        if i < 8 { con prng.bits[i] prng_out[i]; }\n"
+                "    }");
+        replace(result, "import \"alu.sno\";\n", "");
+        return result + "\n" + alu;
+    }
+
+    // large generated program (like ROM-init scripts): a runtime
+    // function holding the gates of Main line by line
+    string holdLines(size_t numLines)
+    {
+        string result = "mod Main\n{\n    let and g[64];\n}\n"
+                        "let runtime()\n{\n";
+        for (size_t line = 0; line < numLines; line++)
+        {
+            if (line % 16 == 0)
+                result += "    # word " + to_string(line / 16) + "\n";
+            result += "    hold g[" + to_string(line % 64) + "] " +
+                      to_string(line % 2) + " " + to_string(line % 7 + 1) +
+                      ";\n";
+        }
+        return result + "    print \"done\\n\";\n}\n";
+    }
+
+    // a decoder like the sncomputer's multiplexer, with its powers of
+    // two computed by a function (whose results are reused)
+    string functionCalls(int bits)
+    {
+        return "let pow2(n)\n{\n"
+               "    if n == 0 { return 1; }\n"
+               "    return 2 * pow2(n - 1);\n}\n"
+               "mod Decoder(bits)\n{\n"
+               "    let or address[bits];\n"
+               "    let and board[pow2(bits)];\n"
+               "    let nor neg[bits];\n"
+               "    con address neg;\n"
+               "    for i in (0, pow2(bits) - 1)\n    {\n"
+               "        for j in (0, bits - 1)\n        {\n"
+               "            if i % pow2(j + 1) < pow2(j) "
+               "{ con neg[j] board[i]; }\n"
+               "            else { con address[j] board[i]; }\n"
+               "        }\n    }\n}\n"
+               "mod Main\n{\n    let Decoder(" +
+               to_string(bits) + ") decoder;\n}\n";
+    }
+
+    vector<Workload> workloads()
+    {
+        vector<Workload> result;
+        string mainText = readFile("main.sno");
+        string aluText = readFile("alu.sno");
+        for (int bits : {6, 8, 10})
+            result.push_back(Workload{
+                "main_bits" + to_string(bits),
+                mainWithBits(mainText, aluText, bits)});
+        result.push_back(Workload{
+            "prng_8bit",
+            "import \"alu.sno\";\nmod Main\n{\n    let Prng_8Bit prng;\n}\n"});
+        for (int bits : {6, 8, 10})
+            result.push_back(Workload{
+                "registers_bits" + to_string(bits),
+                "import \"mem.sno\";\nmod Main\n{\n    let RegisterGroup(" +
+                    to_string(bits) + ") regs;\n}\n"});
+        for (int bits : {8, 10, 12})
+            result.push_back(Workload{
+                "multiplexer_bits" + to_string(bits),
+                "import \"multiplexer.sno\";\nmod Main\n{\n"
+                "    let Multiplexer(" +
+                    to_string(bits) + ") mult;\n}\n"});
+        result.push_back(Workload{"function_calls", functionCalls(10)});
+        result.push_back(Workload{"hold_lines", holdLines(100000)});
+        return result;
+    }
+
+    string jsonString(const string &text)
+    {
+        string result = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            if (c == '\n')
+                result += "\\n";
+            else if ((unsigned char)c >= 0x20)
+                result += c;
+        }
+        return result + "\"";
+    }
+
+    // a workload that doesn't elaborate measures nothing
+    void failWorkload(const Workload &workload, const string &message)
+    {
+        cout << endl;
+        cerr << "Workload '" << workload.name << "' failed: " << message
+             << endl;
+        exit(1);
+    }
+
+    void benchWorkload(const Workload &workload)
+    {
+        const string filename = workload.name + ".sno";
+        const string &text = workload.text;
+        cout << "    {\"name\": " << jsonString(workload.name);
+
+        try
+        {
+            // elaboration is only timed once (it's slow for large
+            // workloads, and there's no need for more precision)
+            lexer::Lexer l(text);
+            interpreter::Interpreter i(
+                parser::Parser(l).parse(), filename,
+                make_shared<const Source>(text));
+            double start = now();
+            size_t allocationsBefore = allocations;
+            i.elaborate();
+            double elaborateSeconds = now() - start;
+            size_t elaborateAllocations = allocations - allocationsBefore;
+
+            // the workload and the files it imported (elaboration loaded
+            // them) are lexed and parsed together.
+            // (the tokens are read one by one, as the parser reads them)
+            size_t sourceBytes = 0;
+            for (auto &source : i.sources())
+                sourceBytes += source->text().size();
+            double lexSeconds = timeRepeated(
+                [&i]()
+                {
+                    for (auto &source : i.sources())
+                    {
+                        lexer::Lexer l(source->text());
+                        while (l.current().type != TT_EOF)
+                            l.next();
+                    }
+                });
+            // the parser lexes as it goes, so parsing is the time lexing
+            // and parsing take together less the time lexing takes
+            double lexParseSeconds = timeRepeated(
+                [&i]()
+                {
+                    for (auto &source : i.sources())
+                    {
+                        lexer::Lexer l(source->text());
+                        parser::Parser(l).parse();
+                    }
+                });
+            double parseSeconds = max(lexParseSeconds - lexSeconds, 0.0);
+
+            // source megabytes lexed and parsed per second
+            double throughput = sourceBytes / lexParseSeconds / 1e6;
+
+            cout << ", \"source_files\": " << i.sources().size()
+                 << ", \"source_bytes\": " << sourceBytes
+                 << ", \"gates\": " << i.netlist().numGates()
+                 << ", \"connections\": " << i.netlist().numConnections()
+                 << ", \"lex_ms\": " << lexSeconds * 1000
+                 << ", \"parse_ms\": " << parseSeconds * 1000
+                 << ", \"lex_parse_mb_per_s\": " << throughput
+                 << ", \"elaborate_ms\": " << elaborateSeconds * 1000
+                 << ", \"elaborate_allocations\": " << elaborateAllocations
+                 << ", \"frames\": " << i.frameStack().numPushes()
+                 << ", \"slot_chunks\": " << i.frameStack().numChunks()
+                 << ", \"cached_results\": {\"hits\": " << i.resultHits()
+                 << ", \"misses\": " << i.resultMisses() << "}"
+                 << ", \"ticks_per_second\": {";
+            bool first = true;
+            for (auto &simMode : SIM_MODES)
+            {
+                Netlist netlist(i.gates(), simMode.mode);
+                // ticks are run in growing batches to keep the overhead
+                // of measuring low
+                size_t ticks = 0, batch = 1;
+                double start = now(), elapsed = 0;
+                do
+                {
+                    netlist.tick(batch);
+                    ticks += batch;
+                    batch *= 2;
+                    elapsed = now() - start;
+                } while (elapsed < MIN_SECONDS);
+                cout << (first ? "" : ", ") << jsonString(simMode.name)
+                     << ": " << ticks / elapsed;
+                first = false;
+            }
+            cout << "}";
+        }
+        catch (err::LexerParserException &e)
+        {
+            failWorkload(workload, e.message);
+        }
+        catch (err::InterpreterException &e)
+        {
+            failWorkload(workload, e.message);
+        }
+        cout << "}";
+    }
+}
+
+int main()
+{
+    auto all = workloads();
+    cout << "{\"workloads\": [" << endl;
+    for (size_t i = 0; i < all.size(); i++)
+    {
+        benchWorkload(all[i]);
+        cout << (i + 1 < all.size() ? "," : "") << endl;
+    }
+    cout << "]}" << endl;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "pos.hpp"
+#include "symbol.hpp"
+
+namespace snowlang::bytecode
+{
+    // Instructions of the interpreter's stack machine.
+    // Numbers are kept on a number stack and items (gates, gate arrays,
+    // modules and module arrays) on an object stack.
+    // `a` and `b` are the instruction's operands (indices into the pools
+    // of its Code unless stated otherwise).
+    enum OpCode : uint8_t
+    {
+        // expressions
+        OP_PUSH, // push numbers[a]
+        OP_LOAD, // push value of variable bindings[a]
+        OP_STORE, // pop into variable bindings[a]
+        OP_POP, // pop a numbers
+        OP_ADD,
+        OP_SUB,
+        OP_MULT,
+        OP_DIV,
+        OP_POW,
+        OP_REM,
+        OP_AND,
+        OP_OR,
+        OP_GT,
+        OP_GE,
+        OP_EQ,
+        OP_NEQ,
+        OP_LE,
+        OP_LT,
+        OP_NEG,
+        OP_NOT,
+        OP_CACHED, // push slot a and jump to instruction b if it's defined
+        OP_CACHE, // copy top of the stack into slot a
+
+        // control flow
+        OP_JUMP, // jump to instruction a
+        OP_JUMP_IF_ZERO, // pop, jump to instruction a if zero
+        OP_PUSH_SCOPE, // clear the slots of scope a (entering it)
+        OP_FOR_FROM, // check lower bound of range on top of the stack
+        OP_FOR_TO, // check bounds of range (from, to) on top of the stack
+        OP_FOR_TEST, // jump to instruction a if loop variable > to
+        OP_FOR_VAR, // set loop variable bindings[a]
+        OP_FOR_NEXT, // increment loop variable
+        OP_RETURN, // pop return value and leave code
+        OP_ERROR, // throw error strings[a]
+
+        // functions and declarations
+        OP_CALL_BEGIN, // look up function bindings[a]
+        OP_ARG, // pop regular argument
+        OP_NAMED_ARG, // pop default argument overwrite names[a]
+        OP_CALL, // call function, push return value
+        OP_PARAMS_BEGIN, // start argument list of a declaration
+        OP_PARAM, // regular argument names[a]
+        OP_DEFAULT, // pop value of default argument names[a]
+        OP_DECLARE_MODULE, // declare module bindings[a] with body codes[b]
+        OP_DECLARE_FUNCTION, // declare function bindings[a] with body codes[b]
+        OP_IMPORT, // import file strings[a]
+
+        // logic
+        OP_CHECK_UNDEFINED, // check names[a] isn't defined in module
+        OP_DEFINE_GATE, // define gate names[a] of type b
+        OP_ARRAY_SIZE, // check array size on top of the stack
+        OP_DEFINE_GATE_ARRAY, // pop size, define gate array names[a]
+        OP_MODULE_BEGIN, // look up module type bindings[a]
+        OP_BUILD_MODULE, // build module with the arguments given
+        OP_DEFINE_MODULE, // define built module names[a]
+        OP_MODULE_ARRAY_BEGIN, // start module array
+        OP_LOOP_COUNT, // jump to a if counter on top is 0, else decrement it
+        OP_APPEND_MODULE, // append built module to module array
+        OP_DEFINE_MODULE_ARRAY, // define module array names[a]
+        OP_ITEM, // push current module
+        OP_SEGMENT, // access member segments[a] of top object
+        OP_CHECK_GATES, // check top object is gate or gate array
+        OP_CON, // pop two objects and connect them
+
+        // runtime
+        OP_PRINT_CHECK, // check items may be printed
+        OP_LANE, // check lane on top of the stack
+        OP_PRINT_ITEM, // pop object (and lane if a) and print it
+        OP_TEXT, // append strings[a] to printed text
+        OP_APPEND_NUMBER, // pop number and append it to printed text
+        OP_PRINT, // print text
+        OP_TICK_CHECK, // check ticks are allowed
+        OP_TICK, // pop number of ticks and tick
+        OP_HOLD_TICKS, // check number of ticks to hold for
+        OP_HOLD_LANE_CHECK, // check lanes can be held
+        OP_HOLD // pop object, ticks (and lane if b), hold as strings[a]
+    };
+
+    struct Instruction
+    {
+        OpCode op;
+        uint32_t a{0};
+        uint32_t b{0};
+    };
+
+    // one identifier of an item (e.g. `b[2]` in `a.b[2].c`)
+    struct Segment
+    {
+        Name name;
+        bool indexed{false};
+        bool last{false};
+        Pos identifierPos;
+        Pos indexPos;
+        Pos nextPos;
+    };
+
+    // A name as seen from one instruction.
+    // Names assigned inside a module or function body or inside a loop or
+    // if statement live in slots of the running frame, one per scope the
+    // name is assigned in. The name is the value of the first of its
+    // slots that is defined, or else it's looked up in the symbol table
+    // the code runs in (which holds globals and runtime variables).
+    struct Binding
+    {
+        Name name;
+        // slots of the enclosing scopes, innermost first
+        std::vector<uint32_t> slots;
+        // whether assigning an undefined name defines it in slots[0]
+        // (rather than in the symbol table)
+        bool local{false};
+
+        // symbol the name was last looked up as in `table`
+        // (symbols are never removed, so it stays valid)
+        mutable const SymbolTable *table{nullptr};
+        mutable SymbolValueType *symbol{nullptr};
+        // number of symbols visible from `table` when the name wasn't found
+        mutable size_t numSymbols{0};
+    };
+
+    // Compiled script, body or instruction.
+    struct Code
+    {
+        std::vector<Instruction> instructions;
+        // position of each instruction (for errors)
+        std::vector<Pos> positions;
+
+        // pools
+        std::vector<Number> numbers;
+        std::vector<std::string> strings;
+        std::vector<Name> names;
+        std::vector<Segment> segments;
+        std::vector<Binding> bindings;
+        // bodies of modules and functions declared by this code
+        std::vector<std::unique_ptr<Code>> codes;
+
+        // slots of each scope (cleared when it's entered)
+        std::vector<std::vector<uint32_t>> scopes;
+        size_t numSlots{0};
+        // bindings of a body's arguments (regular arguments followed by
+        // default arguments in order of declaration)
+        std::vector<uint32_t> params;
+        // whether it builds modules (has OP_BUILD_MODULE instructions)
+        bool buildsModules{false};
+    };
+}
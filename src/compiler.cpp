@@ -0,0 +1,1057 @@
+#include <string>
+#include <algorithm>
+#include <charconv>
+#include "compiler.hpp"
+#include "logic.hpp"
+#include "errorHandler.hpp"
+
+namespace snowlang::bytecode
+{
+    namespace
+    {
+        // parses the whole of `text` (false if it's out of range)
+        template <typename T>
+        bool parse(std::string_view text, T &value)
+        {
+            auto result = std::from_chars(
+                text.data(), text.data() + text.length(), value);
+            return result.ec == std::errc() &&
+                   result.ptr == text.data() + text.length();
+        }
+    }
+
+    std::unique_ptr<Code> Compiler::compile()
+    {
+        auto code = std::make_unique<Code>();
+        m_code = code.get();
+        m_inFunction = false;
+        m_scopes.clear();
+        compile(m_ast.node(m_ast.root));
+        return code;
+    }
+
+    std::unique_ptr<Code> Compiler::compileInstruction()
+    {
+        // runtime instructions behave like the body of the runtime function
+        auto code = std::make_unique<Code>();
+        m_code = code.get();
+        m_inFunction = true;
+        m_scopes.clear();
+        compile(m_ast.node(m_ast.root));
+        return code;
+    }
+
+    size_t Compiler::emit(OpCode op, const Pos &pos, uint32_t a, uint32_t b)
+    {
+        m_code->instructions.push_back(Instruction{op, a, b});
+        m_code->positions.push_back(pos);
+        return m_code->instructions.size() - 1;
+    }
+
+    uint32_t Compiler::string(const std::string &value)
+    {
+        m_code->strings.push_back(value);
+        return m_code->strings.size() - 1;
+    }
+
+    uint32_t Compiler::name(Name value)
+    {
+        m_code->names.push_back(value);
+        return m_code->names.size() - 1;
+    }
+
+    uint32_t Compiler::number(Number value)
+    {
+        m_code->numbers.push_back(value);
+        return m_code->numbers.size() - 1;
+    }
+
+    void Compiler::error(const Pos &pos, const std::string &message)
+    {
+        emit(OP_ERROR, pos, string(message));
+    }
+
+    uint32_t Compiler::scope()
+    {
+        m_code->scopes.emplace_back();
+        m_scopes.push_back(Scope{(uint32_t)m_code->scopes.size() - 1, {}});
+        return m_scopes.back().index;
+    }
+
+    void Compiler::pushScope(const Pos &pos)
+    {
+        emit(OP_PUSH_SCOPE, pos, scope());
+    }
+
+    uint32_t Compiler::binding(Name name, bool assigned)
+    {
+        Binding binding;
+        binding.name = name;
+        // names assigned outside of any scope go to the symbol table
+        if (assigned && !m_scopes.empty())
+        {
+            auto &scope = m_scopes.back();
+            if (scope.slots.count(name) == 0)
+            {
+                scope.slots[name] = m_code->numSlots++;
+                m_code->scopes[scope.index].push_back(scope.slots[name]);
+            }
+            binding.local = true;
+        }
+        // Only names assigned in a scope before this point can be defined
+        // in it (a scope is entered anew whenever control goes back).
+        for (auto scope = m_scopes.rbegin(); scope != m_scopes.rend(); scope++)
+        {
+            auto slot = scope->slots.find(name);
+            if (slot != scope->slots.end())
+                binding.slots.push_back(slot->second);
+        }
+        m_code->bindings.push_back(std::move(binding));
+        return m_code->bindings.size() - 1;
+    }
+
+    uint32_t Compiler::body(const Node *node, bool inFunction,
+                            const std::vector<Name> &params)
+    {
+        auto code = std::make_unique<Code>();
+
+        // save state of the enclosing code
+        Code *enclosing = m_code;
+        bool enclosingInFunction = m_inFunction;
+        auto enclosingScopes = std::move(m_scopes);
+        auto enclosingLoops = std::move(m_loops);
+
+        m_code = code.get();
+        m_inFunction = inFunction;
+        m_scopes.clear();
+        m_loops.clear();
+        // the body's scope, which holds its arguments
+        scope();
+        for (auto &param : params)
+            m_code->params.push_back(binding(param, true));
+        compile(node);
+
+        m_code = enclosing;
+        m_inFunction = enclosingInFunction;
+        m_scopes = std::move(enclosingScopes);
+        m_loops = std::move(enclosingLoops);
+
+        m_code->codes.push_back(std::move(code));
+        return m_code->codes.size() - 1;
+    }
+
+    void Compiler::beginLoop(const Node *node)
+    {
+        Loop loop;
+        scan(node, loop);
+        m_code->scopes.emplace_back();
+        loop.cache = m_code->scopes.size() - 1;
+        emit(OP_PUSH_SCOPE, node->pos, loop.cache);
+        m_loops.push_back(std::move(loop));
+    }
+
+    void Compiler::scan(const Node *node, Loop &loop) const
+    {
+        if (!node)
+            return;
+        switch (node->type)
+        {
+        case NT_BINOP:
+        {
+            auto &value = std::get<BinOpValue>(node->value);
+            scan(m_ast.node(value.left), loop);
+            scan(m_ast.node(value.right), loop);
+            break;
+        }
+        case NT_UNOP:
+            scan(m_ast.node(std::get<UnOpValue>(node->value).node), loop);
+            break;
+        case NT_ITEM:
+        {
+            auto &value = std::get<ItemValue>(node->value);
+            scan(m_ast.node(value.index), loop);
+            scan(m_ast.node(value.next), loop);
+            break;
+        }
+        case NT_DEFINE:
+        {
+            auto &value = std::get<DefineValue>(node->value);
+            if (gateType(m_ast.token(value.typeName)) == GT_NULL)
+                loop.impure = true;
+            scan(m_ast.node(value.arraySize), loop);
+            for (NodeId arg : m_ast.list(value.args))
+                scan(m_ast.node(arg), loop);
+            break;
+        }
+        case NT_CON:
+        {
+            auto &value = std::get<ConValue>(node->value);
+            scan(m_ast.node(value.left), loop);
+            scan(m_ast.node(value.right), loop);
+            break;
+        }
+        case NT_FOR:
+        {
+            auto &value = std::get<ForValue>(node->value);
+            loop.assigned.insert(m_ast.token(value.var).name);
+            scan(m_ast.node(value.from), loop);
+            scan(m_ast.node(value.to), loop);
+            scan(m_ast.node(value.block), loop);
+            break;
+        }
+        case NT_WHILE:
+        {
+            auto &value = std::get<WhileValue>(node->value);
+            scan(m_ast.node(value.cond), loop);
+            scan(m_ast.node(value.block), loop);
+            break;
+        }
+        case NT_RETURN:
+        {
+            auto &value = std::get<ReturnValue>(node->value);
+            scan(m_ast.node(value.expression), loop);
+            break;
+        }
+        case NT_IF:
+        {
+            auto &value = std::get<IfValue>(node->value);
+            for (NodeId cond : m_ast.list(value.conds))
+                scan(m_ast.node(cond), loop);
+            for (NodeId block : m_ast.list(value.ifBlocks))
+                scan(m_ast.node(block), loop);
+            break;
+        }
+        case NT_BLOCK:
+        {
+            auto &value = std::get<BlockValue>(node->value);
+            for (NodeId field : m_ast.list(value.fields))
+                scan(m_ast.node(field), loop);
+            break;
+        }
+        case NT_FUNCDECL:
+        case NT_MOD:
+        {
+            // the body doesn't run here
+            auto &value = std::get<DeclValue>(node->value);
+            loop.assigned.insert(m_ast.token(value.identifier).name);
+            for (NodeId arg : m_ast.list(value.args))
+                scan(m_ast.node(arg), loop);
+            break;
+        }
+        case NT_FUNCCALL:
+        case NT_IMPORT:
+            loop.impure = true;
+            break;
+        case NT_VARASSIGN:
+        {
+            auto &value = std::get<VarAssignValue>(node->value);
+            if (auto identifier = idenFromExpr(m_ast.node(value.lhs)))
+                loop.assigned.insert(identifier->name);
+            scan(m_ast.node(value.rhs), loop);
+            break;
+        }
+        case NT_PRINT:
+        {
+            auto &value = std::get<PrintValue>(node->value);
+            for (NodeId expression : m_ast.list(value.expressions))
+                scan(m_ast.node(expression), loop);
+            scan(m_ast.node(value.item), loop);
+            scan(m_ast.node(value.lane), loop);
+            break;
+        }
+        case NT_TICK:
+            scan(m_ast.node(std::get<TickValue>(node->value).expression), loop);
+            break;
+        case NT_HOLD:
+        {
+            auto &value = std::get<HoldValue>(node->value);
+            scan(m_ast.node(value.item), loop);
+            scan(m_ast.node(value.holdFor), loop);
+            scan(m_ast.node(value.lane), loop);
+            break;
+        }
+        default: // leaves, break and continue
+            break;
+        }
+    }
+
+    void Compiler::compile(const Node *node)
+    {
+        switch (node->type)
+        {
+        case NT_DEFINE:
+            compileDefine(node);
+            break;
+        case NT_CON:
+            compileCon(node);
+            break;
+        case NT_FOR:
+            compileFor(node);
+            break;
+        case NT_WHILE:
+            compileWhile(node);
+            break;
+        case NT_BREAK:
+        case NT_CONTINUE:
+            compileBreakContinue(node);
+            break;
+        case NT_RETURN:
+            compileReturn(node);
+            break;
+        case NT_IF:
+            compileIf(node);
+            break;
+        case NT_BLOCK:
+            compileBlock(node);
+            break;
+        case NT_FUNCDECL:
+        case NT_MOD:
+            compileDecl(node);
+            break;
+        case NT_IMPORT:
+        {
+            auto &strlit = m_ast.token(std::get<LeafValue>(node->value).token);
+            emit(OP_IMPORT, strlit.pos,
+                 string(std::string(
+                     strlit.value.substr(1, strlit.value.length() - 2))));
+            break;
+        }
+        case NT_VARASSIGN:
+            compileVarAssign(node);
+            break;
+        case NT_PRINT:
+            compilePrint(node);
+            break;
+        case NT_TICK:
+            compileTick(node);
+            break;
+        case NT_HOLD:
+            compileHold(node);
+            break;
+        default: // expression
+            compileExpr(node);
+            emit(OP_POP, node->pos, 1);
+            break;
+        }
+    }
+
+    void Compiler::compileExpr(const Node *node)
+    {
+        Number value;
+        if (fold(node, value))
+        {
+            emit(OP_PUSH, node->pos, number(value));
+            return;
+        }
+        Loop *loop = nullptr;
+        // only operations are worth caching
+        if (!m_caching && (node->type == NT_BINOP || node->type == NT_UNOP))
+            loop = invariantLoop(node);
+        if (!loop)
+            return compileOperation(node);
+
+        uint32_t slot = m_code->numSlots++;
+        m_code->scopes[loop->cache].push_back(slot);
+        size_t cached = emit(OP_CACHED, node->pos, slot);
+        m_caching = true;
+        compileOperation(node);
+        m_caching = false;
+        emit(OP_CACHE, node->pos, slot);
+        m_code->instructions[cached].b = (uint32_t)here();
+    }
+
+    void Compiler::compileOperation(const Node *node)
+    {
+        if (node->type == NT_BINOP)
+            compileBinOp(node);
+        else if (node->type == NT_UNOP)
+            compileUnOp(node);
+        else if (node->type == NT_LEAF)
+            compileLeaf(node);
+        else if (node->type == NT_FUNCCALL)
+            compileFuncCall(node);
+    }
+
+    void Compiler::compileBinOp(const Node *node)
+    {
+        auto &value = std::get<BinOpValue>(node->value);
+        compileExpr(m_ast.node(value.left));
+        compileExpr(m_ast.node(value.right));
+        switch (value.operation)
+        {
+        case TT_PLUS:
+            emit(OP_ADD, node->pos);
+            break;
+        case TT_MINUS:
+            emit(OP_SUB, node->pos);
+            break;
+        case TT_MULT:
+            emit(OP_MULT, node->pos);
+            break;
+        case TT_DIV: // division by zero is reported at the right operand
+            emit(OP_DIV, m_ast.node(value.right)->pos);
+            break;
+        case TT_POW:
+            emit(OP_POW, node->pos);
+            break;
+        case TT_REM:
+            emit(OP_REM, node->pos);
+            break;
+        case TT_AND:
+            emit(OP_AND, node->pos);
+            break;
+        case TT_OR:
+            emit(OP_OR, node->pos);
+            break;
+        case TT_GT:
+            emit(OP_GT, node->pos);
+            break;
+        case TT_GE:
+            emit(OP_GE, node->pos);
+            break;
+        case TT_EQ:
+            emit(OP_EQ, node->pos);
+            break;
+        case TT_NEQ:
+            emit(OP_NEQ, node->pos);
+            break;
+        case TT_LE:
+            emit(OP_LE, node->pos);
+            break;
+        case TT_LT:
+            emit(OP_LT, node->pos);
+            break;
+        default:
+            break;
+        }
+    }
+
+    void Compiler::compileUnOp(const Node *node)
+    {
+        auto &value = std::get<UnOpValue>(node->value);
+        compileExpr(m_ast.node(value.node));
+        if (value.operation == TT_MINUS)
+            emit(OP_NEG, node->pos);
+        else if (value.operation == TT_NOT)
+            emit(OP_NOT, node->pos);
+    }
+
+    void Compiler::compileLeaf(const Node *node)
+    {
+        // (numbers are folded unless they're out of range)
+        auto &token = m_ast.token(std::get<LeafValue>(node->value).token);
+        if (token.type == TT_IDEN)
+            emit(OP_LOAD, node->pos, binding(token.name, false));
+        else
+            error(node->pos, err::NUMBER_OUT_OF_RANGE);
+    }
+
+    void Compiler::compileItem(const Node *node)
+    {
+        emit(OP_ITEM, node->pos);
+        for (const Node *item = node; item;)
+        {
+            auto &value = std::get<ItemValue>(item->value);
+            auto &identifier = m_ast.token(value.identifier);
+            const Node *index = m_ast.node(value.index);
+            const Node *next = m_ast.node(value.next);
+            Segment segment;
+            segment.name = identifier.name;
+            segment.identifierPos = identifier.pos;
+            if (index)
+            {
+                compileExpr(index);
+                segment.indexed = true;
+                segment.indexPos = index->pos;
+            }
+            if (next)
+                segment.nextPos = next->pos;
+            else
+                segment.last = true;
+            m_code->segments.push_back(segment);
+            emit(OP_SEGMENT, identifier.pos, m_code->segments.size() - 1);
+            item = next;
+        }
+    }
+
+    void Compiler::compileDefine(const Node *node)
+    {
+        if (m_inFunction)
+            return error(node->pos, err::LOGIC_INSIDE_FUNCTION);
+        auto &value = std::get<DefineValue>(node->value);
+        auto &typeName = m_ast.token(value.typeName);
+        const Node *arraySize = m_ast.node(value.arraySize);
+        uint32_t identifier = name(m_ast.token(value.identifier).name);
+        emit(OP_CHECK_UNDEFINED, m_ast.token(value.identifier).pos,
+             identifier);
+
+        GateType gateType = Compiler::gateType(typeName);
+        bool isGate = (gateType != GT_NULL);
+
+        if (!arraySize) // type is not array
+        {
+            if (isGate)
+                emit(OP_DEFINE_GATE, node->pos, identifier, gateType);
+            else
+            {
+                emit(OP_MODULE_BEGIN, typeName.pos,
+                     binding(typeName.name, false));
+                compileArgs(value.args);
+                emit(OP_BUILD_MODULE, typeName.pos);
+                m_code->buildsModules = true;
+                emit(OP_DEFINE_MODULE, node->pos, identifier);
+            }
+            return;
+        }
+
+        // type is array
+        compileExpr(arraySize);
+        emit(OP_ARRAY_SIZE, arraySize->pos);
+        if (isGate)
+        {
+            emit(OP_DEFINE_GATE_ARRAY, node->pos, identifier, gateType);
+            return;
+        }
+        // build the modules one by one (arguments are evaluated again
+        // for every module)
+        emit(OP_MODULE_ARRAY_BEGIN, node->pos);
+        size_t loop = emit(OP_LOOP_COUNT, node->pos);
+        emit(OP_MODULE_BEGIN, typeName.pos, binding(typeName.name, false));
+        compileArgs(value.args);
+        emit(OP_BUILD_MODULE, typeName.pos);
+        m_code->buildsModules = true;
+        emit(OP_APPEND_MODULE, node->pos);
+        emit(OP_JUMP, node->pos, loop);
+        patch(loop);
+        emit(OP_POP, node->pos, 1);
+        emit(OP_DEFINE_MODULE_ARRAY, node->pos, identifier);
+    }
+
+    void Compiler::compileCon(const Node *node)
+    {
+        if (m_inFunction)
+            return error(node->pos, err::LOGIC_INSIDE_FUNCTION);
+        auto &value = std::get<ConValue>(node->value);
+        const Node *left = m_ast.node(value.left);
+        const Node *right = m_ast.node(value.right);
+        compileItem(left);
+        emit(OP_CHECK_GATES, left->pos);
+        compileItem(right);
+        emit(OP_CHECK_GATES, right->pos);
+        emit(OP_CON, node->pos);
+    }
+
+    void Compiler::compileFor(const Node *node)
+    {
+        auto &value = std::get<ForValue>(node->value);
+        auto &var = m_ast.token(value.var);
+        const Node *from = m_ast.node(value.from);
+
+        // the loop variable and upper bound stay on the stack
+        compileExpr(from);
+        emit(OP_FOR_FROM, from->pos);
+        compileExpr(m_ast.node(value.to));
+        emit(OP_FOR_TO, from->pos);
+
+        beginLoop(node);
+        size_t test = emit(OP_FOR_TEST, node->pos);
+        // child scope with variable as symbol
+        pushScope(node->pos);
+        emit(OP_FOR_VAR, var.pos, binding(var.name, true));
+        compile(m_ast.node(value.block));
+        m_scopes.pop_back();
+
+        Loop loop = std::move(m_loops.back());
+        m_loops.pop_back();
+        for (size_t jump : loop.continues)
+            patch(jump);
+        emit(OP_FOR_NEXT, node->pos);
+        emit(OP_JUMP, node->pos, test);
+        patch(test);
+        for (size_t jump : loop.breaks)
+            patch(jump);
+        emit(OP_POP, node->pos, 2);
+    }
+
+    void Compiler::compileWhile(const Node *node)
+    {
+        auto &value = std::get<WhileValue>(node->value);
+
+        beginLoop(node);
+        size_t cond = here();
+        compileExpr(m_ast.node(value.cond));
+        size_t exit = emit(OP_JUMP_IF_ZERO, node->pos);
+        pushScope(node->pos);
+        compile(m_ast.node(value.block));
+        m_scopes.pop_back();
+
+        Loop loop = std::move(m_loops.back());
+        m_loops.pop_back();
+        for (size_t jump : loop.continues)
+            m_code->instructions[jump].a = cond;
+        emit(OP_JUMP, node->pos, cond);
+        patch(exit);
+        for (size_t jump : loop.breaks)
+            patch(jump);
+    }
+
+    void Compiler::compileBreakContinue(const Node *node)
+    {
+        if (m_loops.empty())
+            return error(node->pos, err::BREAK_CONTINUE_OUTSIDE_LOOP);
+        auto &loop = m_loops.back();
+        size_t jump = emit(OP_JUMP, node->pos);
+        if (node->type == NT_BREAK)
+            loop.breaks.push_back(jump);
+        else
+            loop.continues.push_back(jump);
+    }
+
+    void Compiler::compileReturn(const Node *node)
+    {
+        if (!m_inFunction)
+            return error(node->pos, err::RETURN_OUTSIDE_FUNCTION);
+        compileExpr(m_ast.node(std::get<ReturnValue>(node->value).expression));
+        emit(OP_RETURN, node->pos);
+    }
+
+    void Compiler::compileIf(const Node *node)
+    {
+        auto &value = std::get<IfValue>(node->value);
+        auto conds = m_ast.list(value.conds);
+        auto ifBlocks = m_ast.list(value.ifBlocks);
+        std::vector<size_t> ends;
+        for (size_t i = 0; i < conds.size(); i++)
+        {
+            const Node *cond = m_ast.node(conds[i]);
+            compileExpr(cond);
+            size_t next = emit(OP_JUMP_IF_ZERO, cond->pos);
+            // child scope to current one
+            pushScope(node->pos);
+            compile(m_ast.node(ifBlocks[i]));
+            m_scopes.pop_back();
+            ends.push_back(emit(OP_JUMP, node->pos));
+            patch(next);
+        }
+        // there are more blocks than conditions.
+        // i.e. there's an else block
+        if (ifBlocks.size() > conds.size())
+        {
+            pushScope(node->pos);
+            compile(m_ast.node(ifBlocks[conds.size()]));
+            m_scopes.pop_back();
+        }
+        for (size_t jump : ends)
+            patch(jump);
+    }
+
+    void Compiler::compileBlock(const Node *node)
+    {
+        auto &value = std::get<BlockValue>(node->value);
+        for (NodeId field : m_ast.list(value.fields))
+            compile(m_ast.node(field));
+    }
+
+    void Compiler::compileDecl(const Node *node)
+    {
+        auto &value = std::get<DeclValue>(node->value);
+        auto &identifier = m_ast.token(value.identifier);
+        bool isFunction = (node->type == NT_FUNCDECL);
+        emit(OP_PARAMS_BEGIN, node->pos);
+        std::vector<Name> params;
+        compileParams(value.args, params);
+        uint32_t code = body(m_ast.node(value.body), isFunction, params);
+        emit(isFunction ? OP_DECLARE_FUNCTION : OP_DECLARE_MODULE,
+             identifier.pos, binding(identifier.name, true), code);
+    }
+
+    void Compiler::compileFuncCall(const Node *node)
+    {
+        auto &value = std::get<FuncCallValue>(node->value);
+        auto &identifier = m_ast.token(value.identifier);
+        emit(OP_CALL_BEGIN, identifier.pos, binding(identifier.name, false));
+        compileArgs(value.args);
+        emit(OP_CALL, identifier.pos);
+    }
+
+    void Compiler::compileVarAssign(const Node *node)
+    {
+        auto &value = std::get<VarAssignValue>(node->value);
+        const Node *lhs = m_ast.node(value.lhs);
+        compileExpr(m_ast.node(value.rhs));
+        if (!lhs) // only evaluate rhs if there's no lhs
+        {
+            emit(OP_POP, node->pos, 1);
+            return;
+        }
+        auto identifier = idenFromExpr(lhs);
+        if (!identifier)
+            return error(lhs->pos, err::EXPECTED_LVALUE);
+        emit(OP_STORE, identifier->pos, binding(identifier->name, true));
+    }
+
+    void Compiler::compilePrint(const Node *node)
+    {
+        auto &value = std::get<PrintValue>(node->value);
+        if (value.strlit) // print string literals
+            return compileStrlit(m_ast.token(value.strlit), value.expressions);
+
+        // print item
+        if (m_inFunction) // only allowed in the runtime function
+            emit(OP_PRINT_CHECK, node->pos);
+        compileItem(m_ast.node(value.item));
+        if (value.lane)
+            compileLane(m_ast.node(value.lane));
+        emit(OP_PRINT_ITEM, node->pos, value.lane ? 1 : 0);
+    }
+
+    void Compiler::compileStrlit(
+        const Token &strlit, NodeList expressionList)
+    {
+        auto expressions = m_ast.list(expressionList);
+        std::string_view text = strlit.value;
+        std::string temp;
+        auto flush = [&]()
+        {
+            if (!temp.empty())
+                emit(OP_TEXT, strlit.pos, string(temp));
+            temp.clear();
+        };
+
+        // Go over each character in string.
+        // For bounds not inclusive of first and last characters
+        // To remove the outer quote (`"`) characters.
+        for (size_t i = 1; i < text.length() - 1; i++)
+        {
+            // only try to parse escape sequqnce if current character
+            // is `\` and another character exists before the
+            // closing quote (`"`)
+            if (text[i] == '\\' && i + 1 < text.length() - 1)
+            {
+                if (text[i + 1] == 'n') // newline escape sequence
+                    temp += '\n';
+                else if (text[i + 1] == 't') // tab escape sequence
+                    temp += '\t';
+                else
+                    // if no escape sequence recognized, the `\` will
+                    // be ommitted. e.g. "\g" in the string will become
+                    // just "g" and "\\" in the string will become "\".
+                    temp += text[i + 1];
+                i++;
+                continue;
+            }
+            if (text[i] == '$' && i + 1 < text.length() - 1)
+            {
+                // If the number after `$` is not empty, it will be
+                // treated as an index and the escape sequence will be
+                // replaced with the value of the expression with that
+                // index (evaluated every time it's referenced).
+                std::string number;
+                for (size_t j = i + 1; isdigit(text[j]); j++)
+                    number += text[j];
+                if (!number.empty()) // Escape sequence is index
+                {
+                    int index;
+                    flush();
+                    if (!parse(number, index))
+                        return error(
+                            Pos(strlit.pos.start + i,
+                                strlit.pos.start + i + number.size(),
+                                strlit.pos.fileIndex),
+                            err::NUMBER_OUT_OF_RANGE);
+                    if ((size_t)index >= expressions.size())
+                        return error(
+                            Pos(strlit.pos.start + i,
+                                strlit.pos.start + i + number.size(),
+                                strlit.pos.fileIndex),
+                            err::INDEX_OUT_OF_BOUNDS(
+                                0, (int)expressions.size() - 1, index));
+                    const Node *expression = m_ast.node(expressions[index]);
+                    compileExpr(expression);
+                    emit(OP_APPEND_NUMBER, expression->pos);
+                    i += number.length();
+                    continue;
+                }
+            }
+            temp += text[i];
+        }
+        flush();
+        emit(OP_PRINT, strlit.pos);
+    }
+
+    void Compiler::compileTick(const Node *node)
+    {
+        // modules are never built in the runtime function
+        if (!m_inFunction)
+            return error(node->pos, err::TICK_HOLD_OUTSIDE_RUNTIME);
+        const Node *expression =
+            m_ast.node(std::get<TickValue>(node->value).expression);
+        emit(OP_TICK_CHECK, node->pos);
+        compileExpr(expression);
+        emit(OP_TICK, expression->pos);
+    }
+
+    void Compiler::compileHold(const Node *node)
+    {
+        auto &value = std::get<HoldValue>(node->value);
+        const Node *item = m_ast.node(value.item);
+        const Node *holdFor = m_ast.node(value.holdFor);
+        const Node *lane = m_ast.node(value.lane);
+        auto &holdAs = m_ast.token(value.holdAs);
+        compileItem(item);
+        emit(OP_CHECK_GATES, item->pos);
+        compileExpr(holdFor);
+        emit(OP_HOLD_TICKS, holdFor->pos);
+        if (lane)
+        {
+            emit(OP_HOLD_LANE_CHECK, lane->pos);
+            compileLane(lane);
+        }
+        emit(OP_HOLD, holdAs.pos, string(std::string(holdAs.value)),
+             lane ? 1 : 0);
+    }
+
+    void Compiler::compileLane(const Node *lane)
+    {
+        compileExpr(lane);
+        emit(OP_LANE, lane->pos);
+    }
+
+    void Compiler::compileArgs(NodeList args)
+    {
+        // regular arguments and default argument overwrites
+        bool assignment = false;
+        for (NodeId id : m_ast.list(args))
+        {
+            const Node *arg = m_ast.node(id);
+            auto &value = std::get<VarAssignValue>(arg->value);
+            const Node *lhs = m_ast.node(value.lhs);
+            compileExpr(m_ast.node(value.rhs));
+            if (lhs)
+                assignment = true;
+            if (!assignment)
+            {
+                emit(OP_ARG, arg->pos);
+                continue;
+            }
+            if (!lhs)
+                return error(arg->pos, err::REGULAR_ARG_AFTER_DEFAULT);
+            auto identifier = idenFromExpr(lhs);
+            if (!identifier)
+                return error(lhs->pos, err::EXPECTED_LVALUE);
+            emit(OP_NAMED_ARG, arg->pos, name(identifier->name));
+        }
+    }
+
+    void Compiler::compileParams(NodeList args, std::vector<Name> &names)
+    {
+        bool assignment = false;
+        size_t numRegular = 0;
+        for (NodeId id : m_ast.list(args))
+        {
+            const Node *arg = m_ast.node(id);
+            auto &value = std::get<VarAssignValue>(arg->value);
+            const Node *lhs = m_ast.node(value.lhs);
+            const Node *rhs = m_ast.node(value.rhs);
+            if (lhs)
+                assignment = true;
+            if (!assignment)
+            {
+                auto identifier = idenFromExpr(rhs);
+                if (!identifier)
+                    return error(rhs->pos, err::EXPECTED_LVALUE);
+                emit(OP_PARAM, arg->pos, name(identifier->name));
+                names.push_back(identifier->name);
+                numRegular++;
+                continue;
+            }
+            if (!lhs)
+                return error(arg->pos, err::REGULAR_ARG_AFTER_DEFAULT);
+            // default values are evaluated when declared
+            compileExpr(rhs);
+            auto identifier = idenFromExpr(lhs);
+            if (!identifier)
+                return error(lhs->pos, err::EXPECTED_LVALUE);
+            emit(OP_DEFAULT, arg->pos, name(identifier->name));
+            // a default argument given twice keeps its first place
+            if (std::find(names.begin() + numRegular, names.end(),
+                          identifier->name) == names.end())
+                names.push_back(identifier->name);
+        }
+    }
+
+    const Token *Compiler::idenFromExpr(const Node *expr) const
+    {
+        // (no expression, e.g. the lhs of an expression statement)
+        if (!expr || expr->type != NT_LEAF)
+            return nullptr;
+        auto &token = m_ast.token(std::get<LeafValue>(expr->value).token);
+        return token.type == TT_IDEN ? &token : nullptr;
+    }
+
+    GateType Compiler::gateType(const Token &typeName)
+    {
+        static const Name OR("or"), AND("and"), XOR("xor"),
+            NOR("nor"), NAND("nand"), XNOR("xnor");
+        if (typeName.name == OR)
+            return GT_OR;
+        else if (typeName.name == AND)
+            return GT_AND;
+        else if (typeName.name == XOR)
+            return GT_XOR;
+        else if (typeName.name == NOR)
+            return GT_NOR;
+        else if (typeName.name == NAND)
+            return GT_NAND;
+        else if (typeName.name == XNOR)
+            return GT_XNOR;
+        return GT_NULL;
+    }
+
+    bool Compiler::fold(const Node *expr, Number &value) const
+    {
+        // Folded with the same operations as at runtime, so the results
+        // are the same bit for bit.
+        if (expr->type == NT_LEAF)
+        {
+            auto &token = m_ast.token(std::get<LeafValue>(expr->value).token);
+            // (numbers out of range are left to fail at runtime)
+            if (token.type == TT_INT)
+            {
+                int number;
+                if (!parse(token.value, number))
+                    return false;
+                value = Number(number);
+            }
+            else if (token.type == TT_FLOAT)
+            {
+                float number;
+                if (!parse(token.value, number))
+                    return false;
+                value = Number(number);
+            }
+            else
+                return false;
+            return true;
+        }
+        if (expr->type == NT_UNOP)
+        {
+            auto &unOp = std::get<UnOpValue>(expr->value);
+            if (!fold(m_ast.node(unOp.node), value))
+                return false;
+            if (unOp.operation == TT_MINUS)
+                value = Number::multOp(value, Number(-1));
+            else if (unOp.operation == TT_NOT)
+                value = Number(value.isZero() ? 1 : 0);
+            return true;
+        }
+        if (expr->type != NT_BINOP)
+            return false;
+
+        auto &binOp = std::get<BinOpValue>(expr->value);
+        Number left, right;
+        if (!fold(m_ast.node(binOp.left), left) ||
+            !fold(m_ast.node(binOp.right), right))
+            return false;
+        switch (binOp.operation)
+        {
+        case TT_PLUS:
+            value = Number::addOp(left, right);
+            return true;
+        case TT_MINUS:
+            value = Number::subOp(left, right);
+            return true;
+        case TT_MULT:
+            value = Number::multOp(left, right);
+            return true;
+        case TT_DIV: // division by zero is left to fail at runtime
+            if (right.isZero())
+                return false;
+            value = Number::divOp(left, right);
+            return true;
+        case TT_POW:
+            value = Number::powOp(left, right);
+            return true;
+        case TT_REM: // as is the remainder of floats or of division by 0
+            if (!left.holdsInt() || !right.holdsInt() ||
+                right.getInt() == 0 || right.getInt() == -1)
+                return false;
+            value = Number::remOp(left, right);
+            return true;
+        case TT_AND:
+            value = Number::andOp(left, right);
+            return true;
+        case TT_OR:
+            value = Number::orOp(left, right);
+            return true;
+        case TT_GT:
+            value = Number::gtOp(left, right);
+            return true;
+        case TT_GE:
+            value = Number::geOp(left, right);
+            return true;
+        case TT_EQ:
+            value = Number::eqOp(left, right);
+            return true;
+        case TT_NEQ:
+            value = Number::neqOp(left, right);
+            return true;
+        case TT_LE:
+            value = Number::leOp(left, right);
+            return true;
+        case TT_LT:
+            value = Number::ltOp(left, right);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool Compiler::reads(const Node *expr, std::vector<Name> &names) const
+    {
+        switch (expr->type)
+        {
+        case NT_BINOP:
+        {
+            auto &value = std::get<BinOpValue>(expr->value);
+            return reads(m_ast.node(value.left), names) &&
+                   reads(m_ast.node(value.right), names);
+        }
+        case NT_UNOP:
+        {
+            auto &value = std::get<UnOpValue>(expr->value);
+            return reads(m_ast.node(value.node), names);
+        }
+        case NT_LEAF:
+        {
+            auto &token = m_ast.token(std::get<LeafValue>(expr->value).token);
+            if (token.type == TT_IDEN)
+                names.push_back(token.name);
+            return true;
+        }
+        default: // function call
+            return false;
+        }
+    }
+
+    Compiler::Loop *Compiler::invariantLoop(const Node *expr)
+    {
+        std::vector<Name> names;
+        if (!reads(expr, names))
+            return nullptr;
+        // Names not assigned in a loop that changes no globals keep their
+        // values while it runs.
+        for (auto &loop : m_loops)
+        {
+            if (loop.impure)
+                continue;
+            bool invariant = true;
+            for (auto &name : names)
+                if (loop.assigned.count(name) > 0)
+                    invariant = false;
+            if (invariant)
+                return &loop;
+        }
+        return nullptr;
+    }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include "node.hpp"
+#include "logic.hpp"
+#include "bytecode.hpp"
+
+namespace snowlang::bytecode
+{
+    // Lowers an AST to bytecode.
+    // Names assigned inside bodies, loops and if statements are resolved
+    // to frame slots (see Binding).
+    // Constant expressions are folded and expressions that don't change
+    // while a loop runs are cached in slots the first time they're
+    // evaluated in it (so errors happen exactly where they did).
+    // Errors that can be found without running the code (such as `break`
+    // outside of a loop) become OP_ERROR instructions in place of the
+    // offending instruction, so they're reported at the same point of
+    // execution as before they were found.
+    class Compiler
+    {
+    public:
+        Compiler(const Ast &t_ast) : m_ast(t_ast) {}
+
+        // compiles a script (module and function declarations and imports)
+        std::unique_ptr<Code> compile();
+        // compiles a single runtime instruction (from the console)
+        std::unique_ptr<Code> compileInstruction();
+
+    private:
+        const Ast &m_ast;
+
+        // a loop whose body is being compiled
+        struct Loop
+        {
+            std::vector<size_t> breaks; // jumps to the end of the loop
+            std::vector<size_t> continues; // jumps to the next iteration
+
+            // names assigned in the loop
+            std::unordered_set<Name> assigned;
+            // whether the loop calls functions, builds modules or imports
+            // (which may change any global)
+            bool impure{false};
+            // scope of the slots caching expressions (cleared before the
+            // loop starts)
+            uint32_t cache{0};
+        };
+
+        // a body, loop or if statement whose names have slots
+        struct Scope
+        {
+            uint32_t index; // index in the code's scopes
+            std::unordered_map<Name, uint32_t> slots;
+        };
+
+        // code being compiled and information about it
+        Code *m_code{nullptr};
+        bool m_inFunction{false};
+        std::vector<Scope> m_scopes;
+        std::vector<Loop> m_loops;
+        // whether the expression being compiled is cached
+        bool m_caching{false};
+
+        size_t emit(OpCode op, const Pos &pos,
+                    uint32_t a = 0, uint32_t b = 0);
+        inline size_t here() { return m_code->instructions.size(); }
+        // sets the jump target of instruction `at` to the next instruction
+        inline void patch(size_t at)
+        {
+            m_code->instructions[at].a = (uint32_t)here();
+        }
+        uint32_t string(const std::string &value);
+        uint32_t name(Name value);
+        uint32_t number(Number value);
+        void error(const Pos &pos, const std::string &message);
+        uint32_t scope();
+        void pushScope(const Pos &pos);
+        // binding of name at the current point.
+        // if `assigned`, the name gets a slot in the current scope.
+        uint32_t binding(Name name, bool assigned);
+
+        // compiles the body of a module or function into a new code unit
+        uint32_t body(const Node *node, bool inFunction,
+                      const std::vector<Name> &params);
+
+        // starts a loop (emits the instruction clearing its cache)
+        void beginLoop(const Node *node);
+        // collects what the loop changes
+        void scan(const Node *node, Loop &loop) const;
+
+        void compile(const Node *node);
+        void compileExpr(const Node *node);
+        // compiles an expression without folding or caching it
+        void compileOperation(const Node *node);
+        void compileBinOp(const Node *node);
+        void compileUnOp(const Node *node);
+        void compileLeaf(const Node *node);
+        void compileItem(const Node *node);
+        void compileDefine(const Node *node);
+        void compileCon(const Node *node);
+        void compileFor(const Node *node);
+        void compileWhile(const Node *node);
+        void compileBreakContinue(const Node *node);
+        void compileReturn(const Node *node);
+        void compileIf(const Node *node);
+        void compileBlock(const Node *node);
+        void compileDecl(const Node *node);
+        void compileFuncCall(const Node *node);
+        void compileVarAssign(const Node *node);
+        void compilePrint(const Node *node);
+        void compileStrlit(const Token &strlit, NodeList expressions);
+        void compileTick(const Node *node);
+        void compileHold(const Node *node);
+        void compileLane(const Node *lane);
+
+        // arguments of calls and module definitions
+        void compileArgs(NodeList args);
+        // arguments of declarations (adds their names to `names`)
+        void compileParams(NodeList args, std::vector<Name> &names);
+
+        // returns nullptr if expression is not just an identifier
+        const Token *idenFromExpr(const Node *expr) const;
+        // returns GT_NULL if type name is not a gate type
+        static GateType gateType(const Token &typeName);
+        // evaluates expression if it's constant and can't fail
+        bool fold(const Node *expr, Number &value) const;
+        // adds names read by an expression to `names`.
+        // returns false if it calls functions.
+        bool reads(const Node *expr, std::vector<Name> &names) const;
+        // outermost loop in which an expression doesn't change
+        // (nullptr if none)
+        Loop *invariantLoop(const Node *expr);
+    };
+}
@@ -7,7 +7,7 @@ namespace snowlang::err
     namespace
     {
         int countChar(
-            const string &text,
+            string_view text,
             const int posStart,
             const int posEnd,
             const char c)
@@ -20,7 +20,7 @@ namespace snowlang::err
         }
 
         int posOfNthChar(
-            const string &text,
+            string_view text,
             const char c,
             const int n)
         {
@@ -31,7 +31,7 @@ namespace snowlang::err
             {
                 pos += 1;
                 pos = text.find(c, pos);
-                if ((size_t)pos == string::npos)
+                if ((size_t)pos == string_view::npos)
                     return -1;
                 count++;
             }
@@ -41,7 +41,7 @@ namespace snowlang::err
 
     void fatalErrorAbort(
         Pos pos,
-        const std::string &filename, const std::string &text,
+        const std::string &filename, std::string_view text,
         const std::string &message, bool shouldExit)
     {
         // Get line number and line as a string
@@ -52,7 +52,7 @@ namespace snowlang::err
         int lineEnd = posOfNthChar(text, '\n', lineNumber) - 1;
         if (lineEnd < 0)
             lineEnd = text.length() - 1;
-        string line = text.substr(lineBegin, lineEnd - lineBegin + 1);
+        string line(text.substr(lineBegin, lineEnd - lineBegin + 1));
         int posInLine = pos.start - lineBegin;
         if (posInLine > lineEnd)
         {
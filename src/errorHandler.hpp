@@ -1,9 +1,16 @@
 #include <iostream>
+#include <memory>
+#include <string_view>
 #include "token.hpp"
 #include "node.hpp"
 
 #pragma once
 
+namespace snowlang
+{
+    class Source;
+}
+
 namespace snowlang::err
 {
     // Error messages
@@ -96,6 +103,7 @@ namespace snowlang::err
     const std::string DOES_NOT_NAME_FUNCTION =
         "Runtime error: Expected a function (declared using the 'let' keyword)";
     const std::string DIV_BY_ZERO = "Runtime error: Division by zero.";
+    const std::string NUMBER_OUT_OF_RANGE = "Runtime error: Number out of range.";
     const std::string CONNECT_ARRAY_TO_NOT_ARRAY =
         "Runtime error: Cannot connect object that is not array to object that is array";
     const std::string CONNECT_ARRAY_TO_DIFF_SIZED_ARRAY =
@@ -167,6 +175,9 @@ namespace snowlang::err
 
         return buf;
     }
+    const std::string LANE_MUST_BE_INTEGER = "Runtime error: Lane must be integer.";
+    const std::string LANE_HOLD_OUTSIDE_RUNTIME =
+        "Runtime error: Cannot hold a single lane outside 'runtime' function.";
     const std::string OBJECT_VALUE_ONE_OR_ZERO =
         "Runtime error: Object value must be made up of '0' and '1'.";
     inline std::string FILE_NOT_FOUND(const std::string &filename)
@@ -205,17 +216,20 @@ namespace snowlang::err
     {
     public:
         Pos pos;
-        std::string filename, text, message;
+        std::string filename, message;
+        // text of the file (kept alive until the error is reported)
+        std::shared_ptr<const Source> source;
 
         InterpreterException(
-            const std::string &t_filename, const std::string &t_text,
+            const std::string &t_filename,
+            std::shared_ptr<const Source> t_source,
             Pos t_pos, const std::string &t_message)
-            : pos(t_pos), filename(t_filename), text(t_text),
-              message(t_message) {}
+            : pos(t_pos), filename(t_filename), message(t_message),
+              source(std::move(t_source)) {}
     };
 
     void fatalErrorAbort(
         Pos pos,
-        const std::string &filename, const std::string &text,
+        const std::string &filename, std::string_view text,
         const std::string &message, bool shouldExit = true);
 }
\ No newline at end of file
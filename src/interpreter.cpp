@@ -1,41 +1,103 @@
 #include <string>
-#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <set>
 #include "interpreter.hpp"
 #include "lexer.hpp"
 #include "parser.hpp"
+#include "compiler.hpp"
 
 namespace snowlang::interpreter
 {
+    Interpreter::Interpreter(const Interpreter &parent, bool t_discovering)
+        : m_options(parent.m_options),
+          m_globalModule(std::make_unique<Module>()),
+          m_symbolWrites(parent.m_symbolWrites),
+          buildStack(parent.buildStack),
+          m_parent(&parent), m_speculative(true),
+          m_discovering(t_discovering)
+    {
+    }
+
+    SymbolValueType *FrameStack::push(size_t count)
+    {
+        m_numPushes++;
+        if (count == 0)
+            return nullptr;
+        // skip to the first chunk from the top with enough room
+        while (m_chunk < m_chunks.size() &&
+               m_top + count > m_chunks[m_chunk].size)
+        {
+            m_chunk++;
+            m_top = 0;
+        }
+        if (m_chunk == m_chunks.size())
+        {
+            size_t size = count > chunkSize ? count : chunkSize;
+            m_chunks.push_back(
+                Chunk{std::make_unique<SymbolValueType[]>(size), size});
+        }
+        SymbolValueType *slots = &m_chunks[m_chunk].slots[m_top];
+        std::fill(slots, slots + count, std::monostate());
+        m_top += count;
+        return slots;
+    }
+
     void Interpreter::interpret()
+    {
+        elaborate();
+        run();
+    }
+
+    void Interpreter::elaborate()
     {
         // Global symbol table
-        SymbolTable globalSymbolTable;
-        globalSymbolTable.setSymbol("true", Number(1));
-        globalSymbolTable.setSymbol("false", Number(0));
-        globalSymbolTable.setSymbol("null", Number(0));
+        SymbolTable &globalSymbolTable = m_globalSymbolTable;
+        globalSymbolTable.setSymbol(Name("true"), Number(1));
+        globalSymbolTable.setSymbol(Name("false"), Number(0));
+        globalSymbolTable.setSymbol(Name("null"), Number(0));
 
-        auto globalModule = std::make_unique<Module>();
-        Context ctx(globalSymbolTable, *globalModule);
-        visit(m_ast, ctx);
+        m_globalModule = std::make_unique<Module>();
+        m_units.push_back(bytecode::Compiler(m_ast).compile());
+        // the code doesn't refer to the tree
+        m_ast = Ast();
+        execute(*m_units.back(), globalSymbolTable, *m_globalModule);
 
         // Build module 'Main'.
-        globalModule = buildModule(ctx, "Main", Pos());
+        // (its gates are in the arena of the global module)
+        if (m_options.numThreads > 1)
+            m_threadPool = std::make_unique<ThreadPool>(m_options.numThreads);
+        Frame frame(globalSymbolTable, *m_globalModule, m_frameStack);
+        Name main("Main");
+        auto call = beginBuild(globalSymbolTable.lookup(main), main, Pos());
+        m_mainModule = buildModule(frame, call, Pos());
+
+        // Flatten 'Main' for simulation.
+        m_netlist = std::make_unique<Netlist>(
+            m_globalModule->arena, m_options.simMode, m_options.numThreads);
+        if (m_options.simMode == SM_JIT && !m_netlist->compiled())
+            std::cout << "Could not compile circuit."
+                      << " Simulating as with '--sim=sweep'." << std::endl;
+    }
+
+    void Interpreter::run()
+    {
+        SymbolTable &globalSymbolTable = m_globalSymbolTable;
 
-        // runtime symbol table and context
+        // runtime symbol table
         SymbolTable runtimeSymbolTable(&globalSymbolTable);
         runtimeSymbolTable.setSymbol(
-            "num_gates",
-            Number((int)globalModule->numGates()));
+            Name("num_gates"),
+            Number((int)m_netlist->numGates()));
         runtimeSymbolTable.setSymbol(
-            "num_connections",
-            Number((int)globalModule->numConnections()));
-        Context runtimeCtx(runtimeSymbolTable, *globalModule);
-        runtimeCtx.inRuntime = true;
-        runtimeCtx.inFunction = true;
+            Name("num_connections"),
+            Number((int)m_netlist->numConnections()));
+        runtimeSymbolTable.setSymbol(
+            Name("lanes"),
+            Number((int)m_netlist->numLanes()));
 
         // Look up runtime function
-        std::string name = "runtime";
-        auto runtimeSymbol = globalSymbolTable.lookup(name);
+        auto runtimeSymbol = globalSymbolTable.lookup(Name("runtime"));
         if (runtimeSymbol) // runtime defined
         {
             if (!std::holds_alternative<FunctionDeclaration>(*runtimeSymbol))
@@ -44,7 +106,8 @@ namespace snowlang::interpreter
                 std::get<FunctionDeclaration>(*runtimeSymbol);
 
             // Execute runtime function
-            visit(runtimeFunction.body, runtimeCtx);
+            execute(*runtimeFunction.body, runtimeSymbolTable,
+                    *m_mainModule, true);
         }
         else // runtime undefined - take runtime instructions from console
         {
@@ -69,27 +132,26 @@ namespace snowlang::interpreter
                 if (text == "quit")
                     break;
                 importedFiles.push_back(filename);
-                files.push_back(text);
+                files.push_back(std::make_shared<const Source>(std::move(text)));
+                std::string_view source = files.back()->text();
                 try
                 {
-                    // Lex it
-                    lexer::Lexer l(text, importedFiles.size() - 1);
-                    auto tokens = l.lex();
-
-                    // Parse it
-                    parser::Parser p(tokens, importedFiles.size() - 1);
-                    auto ast = p.parseInstruction();
-
-                    // Interpret it
-                    visit(ast, runtimeCtx);
+                    // Lex and parse it, compile it (freeing the tree)
+                    // and run it
+                    lexer::Lexer l(source, importedFiles.size() - 1);
+                    parser::Parser p(l, importedFiles.size() - 1);
+                    auto code = bytecode::Compiler(p.parseInstruction())
+                                    .compileInstruction();
+                    execute(*code, runtimeSymbolTable, *m_mainModule, true);
                 }
                 catch (err::LexerParserException &e)
                 {
-                    err::fatalErrorAbort(e.pos, filename, text, e.message, false);
+                    err::fatalErrorAbort(e.pos, filename, source, e.message, false);
                 }
                 catch (err::InterpreterException &e)
                 {
-                    err::fatalErrorAbort(e.pos, e.filename, e.text, e.message, false);
+                    err::fatalErrorAbort(e.pos, e.filename, e.source->text(),
+                                         e.message, false);
                 }
                 importedFiles.pop_back();
                 files.pop_back();
@@ -97,878 +159,962 @@ namespace snowlang::interpreter
         }
     }
 
-    std::unique_ptr<Module> Interpreter::buildModule(
-        Context &ctx,
-        std::string typeName, Pos pos,
-        const std::vector<std::unique_ptr<Node>> &args)
+    Number Interpreter::execute(
+        const bytecode::Code &code,
+        SymbolTable &symbolTable, Module &logic, bool inRuntime)
     {
-        // Check for circular construction
-        if (!buildStack.empty() &&
-            std::count(buildStack.begin(),
-                       buildStack.end(), typeName) > 0)
-            error(pos, err::CIRCULAR_CONSTRUCTION);
-        buildStack.push_back(typeName);
-
-        // Get module declaration
-        auto typeNameSymbol = ctx.symbolTable.lookup(typeName);
-        if (!typeNameSymbol)
-            error(pos, err::IDENTIFIER_UNDEFINED(typeName));
-        if (!std::holds_alternative<ModuleDeclaration>(*typeNameSymbol))
-            error(pos, err::DOES_NOT_NAME_MODULE_TYPE);
-        auto &moduleDecl = std::get<ModuleDeclaration>(*typeNameSymbol);
-
-        // visit body node
-        auto mod = std::make_unique<Module>();
-        auto buildSymbolTable =
-            SymbolTable(ctx.symbolTable.firstAncestor());
-        populateArgs(ctx, buildSymbolTable, moduleDecl.args, args, pos);
-
-        Context buildCtx(buildSymbolTable, *mod);
-        visit(moduleDecl.body, buildCtx);
-        buildStack.pop_back();
-        return mod;
+        Frame frame(symbolTable, logic, m_frameStack, inRuntime,
+                    code.numSlots);
+        return execute(code, frame);
     }
 
-    NodeReturnType Interpreter::visit(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    Number Interpreter::execute(const bytecode::Code &code, Frame &frame)
     {
-        if (node->type == NT_BINOP)
-            return visitBinOp(node, ctx);
-        else if (node->type == NT_UNOP)
-            return visitUnOp(node, ctx);
-        else if (node->type == NT_LEAF)
-            return visitLeaf(node, ctx);
-        else if (node->type == NT_ITEM)
-            return visitItem(node, ctx);
-        else if (node->type == NT_DEFINE)
-            return visitDefine(node, ctx);
-        else if (node->type == NT_CON)
-            return visitCon(node, ctx);
-        else if (node->type == NT_FOR)
-            return visitFor(node, ctx);
-        else if (node->type == NT_WHILE)
-            return visitWhile(node, ctx);
-        else if (node->type == NT_BREAK)
-            return visitBreak(node, ctx);
-        else if (node->type == NT_CONTINUE)
-            return visitContinue(node, ctx);
-        else if (node->type == NT_RETURN)
-            return visitReturn(node, ctx);
-        else if (node->type == NT_IF)
-            return visitIf(node, ctx);
-        else if (node->type == NT_BLOCK)
-            return visitBlock(node, ctx);
-        else if (node->type == NT_FUNCDECL)
-            return visitFuncDecl(node, ctx);
-        else if (node->type == NT_FUNCCALL)
-            return visitFuncCall(node, ctx);
-        else if (node->type == NT_IMPORT)
-            return visitImport(node, ctx);
-        else if (node->type == NT_MOD)
-            return visitMod(node, ctx);
-        else if (node->type == NT_VARASSIGN)
-            return visitVarAssign(node, ctx);
-        else if (node->type == NT_PRINT)
-            return visitPrint(node, ctx);
-        else if (node->type == NT_TICK)
-            return visitTick(node, ctx);
-        else if (node->type == NT_HOLD)
-            return visitHold(node, ctx);
-        return std::monostate();
-    }
+        using namespace bytecode;
 
-    NodeReturnType Interpreter::visitBinOp(
-        const std::unique_ptr<Node> &node, Context &ctx)
-    {
-        auto &value = std::get<BinOpValue>(node->value);
-        auto left = std::get<Number>(visit(value.left, ctx));
-        auto right = std::get<Number>(visit(value.right, ctx));
-        if (value.operationToken.type == TT_PLUS)
-            return Number::addOp(left, right);
-        else if (value.operationToken.type == TT_MINUS)
-            return Number::subOp(left, right);
-        else if (value.operationToken.type == TT_MULT)
-            return Number::multOp(left, right);
-        else if (value.operationToken.type == TT_DIV)
-        {
-            if (right.isZero())
-                error(value.right->pos, err::DIV_BY_ZERO);
-            return Number::divOp(left, right);
-        }
-        else if (value.operationToken.type == TT_POW)
-            return Number::powOp(left, right);
-        else if (value.operationToken.type == TT_REM)
-        {
-            if (!left.holdsInt() || !right.holdsInt())
-                error(node->pos, err::INT_ONLY_OP);
-            return Number::remOp(left, right);
-        }
-        else if (value.operationToken.type == TT_AND)
-            return Number::andOp(left, right);
-        else if (value.operationToken.type == TT_OR)
-            return Number::orOp(left, right);
-        else if (value.operationToken.type == TT_GT)
-            return Number::gtOp(left, right);
-        else if (value.operationToken.type == TT_GE)
-            return Number::geOp(left, right);
-        else if (value.operationToken.type == TT_EQ)
-            return Number::eqOp(left, right);
-        else if (value.operationToken.type == TT_NEQ)
-            return Number::neqOp(left, right);
-        else if (value.operationToken.type == TT_LE)
-            return Number::leOp(left, right);
-        else if (value.operationToken.type == TT_LT)
-            return Number::ltOp(left, right);
-        return std::monostate();
-    }
+        auto &numbers = frame.numbers;
 
-    NodeReturnType Interpreter::visitUnOp(
-        const std::unique_ptr<Node> &node, Context &ctx)
-    {
-        auto &value = std::get<UnOpValue>(node->value);
-        auto operand = std::get<Number>(visit(value.node, ctx));
-        if (value.operationToken.type == TT_MINUS)
-        {
-            return Number::multOp(operand, Number(-1));
-        }
-        else if (value.operationToken.type == TT_NOT)
+        size_t ip = 0;
+        const size_t end = code.instructions.size();
+        while (ip < end)
         {
-            if (operand.isZero())
-                return Number(1);
-            else
-                return Number(0);
-        }
-        else if (value.operationToken.type == TT_PLUS)
-            return operand;
-        return std::monostate();
-    }
-
-    NodeReturnType Interpreter::visitLeaf(
-        const std::unique_ptr<Node> &node, Context &ctx)
-    {
-        auto &token = std::get<LeafValue>(node->value).token;
-        if (token.type == TT_INT)
-        {
-            return Number(std::stoi(token.value));
-        }
-        else if (token.type == TT_FLOAT)
-        {
-            return Number(std::stof(token.value));
-        }
-        else if (token.type == TT_IDEN)
-        {
-            auto *idenValue = ctx.symbolTable.lookup(token.value);
-            if (!idenValue)
-                error(node->pos, err::IDENTIFIER_UNDEFINED(token.value));
-            if (!std::holds_alternative<Number>(*idenValue))
-                error(token.pos, err::EXPECTED_NUMBER);
-            return std::get<Number>(*idenValue);
-        }
-        return std::monostate();
-    }
-
-    NodeReturnType Interpreter::visitItem(
-        const std::unique_ptr<Node> &node, Context &ctx)
-    {
-        // Used to hold the current module. Does not own the Module.
-        Module *currModule = &ctx.logic;
-        // Used to iterate over the item subtree.
-        // Does not own the pointed to node.
-        Node *item = node.get();
-        while (item)
-        {
-            auto &value = std::get<ItemValue>(item->value);
-            auto &currIden = value.identifier.value;
-            if (value.index) // current identifier is indexed
+            const Instruction &instruction = code.instructions[ip];
+            const Pos &pos = code.positions[ip];
+            ip++;
+            switch (instruction.op)
             {
-                auto num = visit(value.index, ctx);
-                auto indexNumber = std::get<Number>(
-                    num);
-                if (!indexNumber.holdsInt())
-                    error(value.index->pos, err::INDEX_MUST_BE_INTEGER);
-                int index = indexNumber.getInt();
-
-                if (currModule->gateArrays.count(currIden) > 0)
-                { // found gate array
-                    if (value.next)
-                        error(value.next->pos, err::NO_MEMBER_TO_ACCESS);
-
-                    // Check if index is out of bounds
-                    if (index < 0 ||
-                        index >= (int)currModule->gateArrays[currIden].size())
-                    {
-                        error(
-                            value.index->pos,
-                            err::INDEX_OUT_OF_BOUNDS(
-                                0,
-                                currModule->gateArrays[currIden].size() - 1,
-                                index));
-                    }
-                    return &currModule->gateArrays[currIden][index];
-                }
-                else if (currModule->moduleArrays.count(currIden) > 0)
-                {
-                    if (index < 0 ||
-                        index >= (int)currModule->moduleArrays[currIden].size())
-                    {
-                        error(
-                            value.index->pos,
-                            err::INDEX_OUT_OF_BOUNDS(
-                                0,
-                                currModule->moduleArrays[currIden].size() - 1,
-                                index));
-                    }
-                    currModule = currModule->moduleArrays[currIden][index].get();
-                    if (!value.next)
-                        return currModule;
-                }
-                else
-                    error(
-                        value.identifier.pos,
-                        err::MEMBER_ARRAY_UNDEFINED);
+            // expressions
+            case OP_PUSH:
+                numbers.push_back(code.numbers[instruction.a]);
+                break;
+            case OP_LOAD:
+            {
+                auto &binding = code.bindings[instruction.a];
+                auto *idenValue = resolve(frame, binding);
+                if (!idenValue)
+                    error(pos, err::IDENTIFIER_UNDEFINED(binding.name.str()));
+                if (!std::holds_alternative<Number>(*idenValue))
+                    error(pos, err::EXPECTED_NUMBER);
+                numbers.push_back(std::get<Number>(*idenValue));
+                break;
+            }
+            case OP_STORE:
+            {
+                auto errmsg = assign(
+                    frame, code.bindings[instruction.a], frame.pop());
+                if (errmsg != err::NOERR)
+                    error(pos, errmsg);
+                break;
+            }
+            case OP_POP:
+                numbers.resize(numbers.size() - instruction.a);
+                break;
+            case OP_ADD:
+            {
+                Number right = frame.pop();
+                numbers.back() = Number::addOp(numbers.back(), right);
+                break;
+            }
+            case OP_SUB:
+            {
+                Number right = frame.pop();
+                numbers.back() = Number::subOp(numbers.back(), right);
+                break;
+            }
+            case OP_MULT:
+            {
+                Number right = frame.pop();
+                numbers.back() = Number::multOp(numbers.back(), right);
+                break;
+            }
+            case OP_DIV:
+            {
+                Number right = frame.pop();
+                if (right.isZero())
+                    error(pos, err::DIV_BY_ZERO);
+                numbers.back() = Number::divOp(numbers.back(), right);
+                break;
+            }
+            case OP_POW:
+            {
+                Number right = frame.pop();
+                numbers.back() = Number::powOp(numbers.back(), right);
+                break;
+            }
+            case OP_REM:
+            {
+                Number right = frame.pop();
+                if (!numbers.back().holdsInt() || !right.holdsInt())
+                    error(pos, err::INT_ONLY_OP);
+                numbers.back() = Number::remOp(numbers.back(), right);
+                break;
+            }
+            case OP_AND:
+            {
+                Number right = frame.pop();
+                numbers.back() = Number::andOp(numbers.back(), right);
+                break;
+            }
+            case OP_OR:
+            {
+                Number right = frame.pop();
+                numbers.back() = Number::orOp(numbers.back(), right);
+                break;
             }
-            else // current identifier is not indexed
+            case OP_GT:
             {
-                if (currModule->gates.count(currIden) > 0)
-                { // found gate
-                    if (value.next)
-                        error(value.next->pos,
-                              err::NO_MEMBER_TO_ACCESS);
-                    return &currModule->gates[currIden];
+                Number right = frame.pop();
+                numbers.back() = Number::gtOp(numbers.back(), right);
+                break;
+            }
+            case OP_GE:
+            {
+                Number right = frame.pop();
+                numbers.back() = Number::geOp(numbers.back(), right);
+                break;
+            }
+            case OP_EQ:
+            {
+                Number right = frame.pop();
+                numbers.back() = Number::eqOp(numbers.back(), right);
+                break;
+            }
+            case OP_NEQ:
+            {
+                Number right = frame.pop();
+                numbers.back() = Number::neqOp(numbers.back(), right);
+                break;
+            }
+            case OP_LE:
+            {
+                Number right = frame.pop();
+                numbers.back() = Number::leOp(numbers.back(), right);
+                break;
+            }
+            case OP_LT:
+            {
+                Number right = frame.pop();
+                numbers.back() = Number::ltOp(numbers.back(), right);
+                break;
+            }
+            case OP_NEG:
+                numbers.back() = Number::multOp(numbers.back(), Number(-1));
+                break;
+            case OP_NOT:
+                numbers.back() = Number(numbers.back().isZero() ? 1 : 0);
+                break;
+            case OP_CACHED:
+                if (std::holds_alternative<Number>(frame.slots[instruction.a]))
+                {
+                    numbers.push_back(
+                        std::get<Number>(frame.slots[instruction.a]));
+                    ip = instruction.b;
                 }
-                else if (currModule->gateArrays.count(currIden) > 0)
-                { // found gate array
-                    if (value.next)
-                        error(
-                            value.next->pos, err::NO_MEMBER_TO_ACCESS);
+                break;
+            case OP_CACHE:
+                frame.slots[instruction.a] = numbers.back();
+                break;
 
-                    return &currModule->gateArrays[currIden];
-                }
-                else if (currModule->modules.count(currIden) > 0)
+            // control flow
+            case OP_JUMP:
+                ip = instruction.a;
+                break;
+            case OP_JUMP_IF_ZERO:
+                if (frame.pop().isZero())
+                    ip = instruction.a;
+                break;
+            case OP_PUSH_SCOPE:
+                for (uint32_t slot : code.scopes[instruction.a])
+                    frame.slots[slot] = std::monostate();
+                break;
+            case OP_FOR_FROM:
+                if (!numbers.back().holdsInt())
+                    error(pos, err::RANGE_BOUND_MUST_BE_INTEGER);
+                break;
+            case OP_FOR_TO:
+                if (numbers[numbers.size() - 2].getInt() >
+                    numbers.back().getInt())
+                    error(pos, err::LOWER_BOUND_GT_UPPER_BOUND);
+                break;
+            case OP_FOR_TEST:
+                if (numbers[numbers.size() - 2].getInt() >
+                    numbers.back().getInt())
+                    ip = instruction.a;
+                break;
+            case OP_FOR_VAR:
+                assign(frame, code.bindings[instruction.a],
+                       numbers[numbers.size() - 2]);
+                break;
+            case OP_FOR_NEXT:
+            {
+                Number &var = numbers[numbers.size() - 2];
+                var = Number(var.getInt() + 1);
+                break;
+            }
+            case OP_RETURN:
+                return frame.pop();
+            case OP_ERROR:
+                error(pos, code.strings[instruction.a]);
+                break;
+
+            // functions and declarations
+            case OP_CALL_BEGIN:
+            {
+                auto &binding = code.bindings[instruction.a];
+                frame.calls.push_back(
+                    beginCall(resolve(frame, binding), binding.name, pos));
+                break;
+            }
+            case OP_ARG:
+            {
+                auto &call = frame.calls.back();
+                call.argPositions.push_back(pos);
+                call.argValues.push_back(frame.pop());
+                break;
+            }
+            case OP_NAMED_ARG:
+            {
+                auto &call = frame.calls.back();
+                auto &name = code.names[instruction.a];
+                auto &defaultNames = call.args->defaultNames;
+                call.argPositions.push_back(pos);
+                auto defaultArg = std::find(
+                    defaultNames.begin(), defaultNames.end(), name);
+                if (defaultArg == defaultNames.end())
+                    error(pos, err::NO_SUCH_DEFAULT_ARG(name.str()));
+                call.defaultValues[defaultArg - defaultNames.begin()] =
+                    frame.pop();
+                break;
+            }
+            case OP_CALL:
+            {
+                Call call = std::move(frame.calls.back());
+                frame.calls.pop_back();
+                numbers.push_back(callFunction(frame, call, pos));
+                break;
+            }
+            case OP_PARAMS_BEGIN:
+                frame.params = Args();
+                break;
+            case OP_PARAM:
+                frame.params.argNames.push_back(code.names[instruction.a]);
+                break;
+            case OP_DEFAULT:
+            {
+                // a default argument given twice keeps its first place
+                auto &name = code.names[instruction.a];
+                auto &defaultNames = frame.params.defaultNames;
+                auto defaultArg = std::find(
+                    defaultNames.begin(), defaultNames.end(), name);
+                if (defaultArg != defaultNames.end())
                 {
-                    currModule = currModule->modules[currIden].get();
-                    if (!value.next)
-                        return currModule;
+                    frame.params.defaultValues[
+                        defaultArg - defaultNames.begin()] = frame.pop();
+                    break;
                 }
-                else if (currModule->moduleArrays.count(currIden) > 0)
+                defaultNames.push_back(name);
+                frame.params.defaultValues.push_back(frame.pop());
+                break;
+            }
+            case OP_DECLARE_MODULE:
+                declare(frame, code.bindings[instruction.a],
+                        ModuleDeclaration(
+                            frame.params, code.codes[instruction.b].get()),
+                        pos);
+                break;
+            case OP_DECLARE_FUNCTION:
+                declare(frame, code.bindings[instruction.a],
+                        FunctionDeclaration(
+                            frame.params, code.codes[instruction.b].get()),
+                        pos);
+                break;
+            case OP_IMPORT:
+                sideEffect();
+                import(frame, code.strings[instruction.a], pos);
+                break;
+
+            // logic
+            case OP_CHECK_UNDEFINED:
+                if (frame.logic.alreadyDefined(code.names[instruction.a]))
+                    error(pos, err::ALREADY_DEFINED);
+                break;
+            case OP_DEFINE_GATE:
+                frame.logic.gates[code.names[instruction.a]] =
+                    frame.logic.arena.add((GateType)instruction.b);
+                frame.logic.definitionOrder.push_back(
+                    code.names[instruction.a]);
+                break;
+            case OP_ARRAY_SIZE:
+                if (!numbers.back().holdsInt() || numbers.back().getInt() < 0)
+                    error(pos, err::EXPECTED_POS_INT);
+                break;
+            case OP_DEFINE_GATE_ARRAY:
+                frame.logic.gateArrays[code.names[instruction.a]] =
+                    frame.logic.arena.add(
+                        (GateType)instruction.b,
+                        (uint32_t)frame.pop().getInt());
+                frame.logic.definitionOrder.push_back(
+                    code.names[instruction.a]);
+                break;
+            case OP_MODULE_BEGIN:
+            {
+                auto &binding = code.bindings[instruction.a];
+                frame.calls.push_back(
+                    beginBuild(resolve(frame, binding), binding.name, pos));
+                break;
+            }
+            case OP_BUILD_MODULE:
+            {
+                Call call = std::move(frame.calls.back());
+                frame.calls.pop_back();
+                if (m_discovering)
                 {
-                    if (value.next)
-                        error(
-                            value.next->pos, err::NO_MEMBER_TO_ACCESS);
-                    return &currModule->moduleArrays[currIden];
+                    // record the build and go on with an empty module
+                    m_pendingBuilds.push_back(PendingBuild{
+                        buildStack.back(), *call.args, call.body,
+                        call.argValues, call.defaultValues});
+                    buildStack.pop_back();
+                    frame.modules.push_back(
+                        std::make_unique<Module>(frame.logic.arena));
+                    break;
                 }
-                else
-                    error(value.identifier.pos, err::MEMBER_UNDEFINED);
+                frame.modules.push_back(buildModule(frame, call, pos));
+                break;
             }
-            item = value.next.get();
-        }
-        error(node->pos, err::OBJECT_TYPE_INCORRECT);
-        return std::monostate();
-    }
+            case OP_DEFINE_MODULE:
+                frame.logic.modules[code.names[instruction.a]] =
+                    std::move(frame.modules.back());
+                frame.logic.definitionOrder.push_back(
+                    code.names[instruction.a]);
+                frame.modules.pop_back();
+                break;
+            case OP_MODULE_ARRAY_BEGIN:
+                frame.moduleArrays.emplace_back();
+                break;
+            case OP_LOOP_COUNT:
+                if (numbers.back().getInt() <= 0)
+                    ip = instruction.a;
+                else
+                    numbers.back() = Number(numbers.back().getInt() - 1);
+                break;
+            case OP_APPEND_MODULE:
+                frame.moduleArrays.back().push_back(
+                    std::move(frame.modules.back()));
+                frame.modules.pop_back();
+                break;
+            case OP_DEFINE_MODULE_ARRAY:
+                frame.logic.moduleArrays[code.names[instruction.a]] =
+                    std::move(frame.moduleArrays.back());
+                frame.logic.definitionOrder.push_back(
+                    code.names[instruction.a]);
+                frame.moduleArrays.pop_back();
+                break;
+            case OP_ITEM:
+                if (m_discovering)
+                    throw SpeculationFailed();
+                frame.objects.push_back(&frame.logic);
+                break;
+            case OP_SEGMENT:
+                accessMember(frame, code.segments[instruction.a]);
+                break;
+            case OP_CHECK_GATES:
+                if (!std::holds_alternative<Gate>(frame.objects.back()) &&
+                    !std::holds_alternative<GateArray>(frame.objects.back()))
+                    error(pos, err::OBJECT_TYPE_INCORRECT);
+                break;
+            case OP_CON:
+                connect(frame, pos);
+                break;
 
-    NodeReturnType Interpreter::visitDefine(
-        const std::unique_ptr<Node> &node, Context &ctx)
-    {
-        if (ctx.inFunction)
-            error(node->pos, err::LOGIC_INSIDE_FUNCTION);
-        auto &value = std::get<DefineValue>(node->value);
-        auto &typeName = value.typeName.value;
-        auto &identifier = value.identifier.value;
-        if (ctx.logic.alreadyDefined(value.identifier.value))
-            error(value.identifier.pos, err::ALREADY_DEFINED);
-        GateType gateType = GT_NULL;
-        if (typeName == "or")
-            gateType = GT_OR;
-        else if (typeName == "and")
-            gateType = GT_AND;
-        else if (typeName == "xor")
-            gateType = GT_XOR;
-        else if (typeName == "nor")
-            gateType = GT_NOR;
-        else if (typeName == "nand")
-            gateType = GT_NAND;
-        else if (typeName == "xnor")
-            gateType = GT_XNOR;
-        bool isGate = (gateType != GT_NULL);
-
-        if (!value.arraySize) // type is not array
-        {
-            if (isGate)
-                ctx.logic.gates[identifier] = LogicGate(gateType);
-            else
-                ctx.logic.modules[identifier] = std::move(
-                    buildModule(
-                        ctx, typeName,
-                        value.typeName.pos,
-                        value.args));
-        }
-        else // type is array
-        {
-            auto num = visit(value.arraySize, ctx);
-            auto sizeNumber = std::get<Number>(
-                num);
-            if (!sizeNumber.holdsInt() || sizeNumber.getInt() < 0)
-                error(value.arraySize->pos, err::EXPECTED_POS_INT);
-            int size = sizeNumber.getInt();
-            if (isGate)
+            // runtime
+            case OP_PRINT_CHECK:
+                if (!frame.inRuntime)
+                    error(pos, err::LOGIC_INSIDE_FUNCTION);
+                break;
+            case OP_LANE:
+                checkLane(frame, pos);
+                break;
+            case OP_PRINT_ITEM:
             {
-                ctx.logic.gateArrays[identifier] =
-                    std::vector<LogicGate>(size, LogicGate(gateType));
+                sideEffect();
+                size_t lane = 0;
+                if (instruction.a)
+                    lane = frame.pop().getInt();
+                Object object = frame.objects.back();
+                frame.objects.pop_back();
+                printObject(frame, object, 0, lane);
+                break;
             }
-            else
+            case OP_TEXT:
+                frame.text += code.strings[instruction.a];
+                break;
+            case OP_APPEND_NUMBER:
+                frame.text += frame.pop().repr();
+                break;
+            case OP_PRINT:
+                sideEffect();
+                std::cout << frame.text;
+                frame.text.clear();
+                break;
+            case OP_TICK_CHECK:
+                if (!frame.inRuntime)
+                    error(pos, err::TICK_HOLD_OUTSIDE_RUNTIME);
+                break;
+            case OP_TICK:
             {
-                std::vector<std::unique_ptr<Module>> moduleArray;
-                for (int i = 0; i < size; i++)
-                    moduleArray.push_back(
-                        buildModule(
-                            ctx,
-                            value.typeName.value,
-                            value.typeName.pos,
-                            value.args));
-                ctx.logic.moduleArrays[identifier] =
-                    std::move(moduleArray);
+                // Make sure the number of ticks is a positive integer.
+                Number tickNumber = frame.pop();
+                if (!tickNumber.holdsInt() || tickNumber.getInt() <= 0)
+                    error(pos, err::EXPECTED_POS_INT);
+                // Update all gates
+                sideEffect();
+                m_netlist->tick(tickNumber.getInt());
+                break;
+            }
+            case OP_HOLD_TICKS:
+                if (!numbers.back().holdsInt() || numbers.back().getInt() <= 0)
+                    error(pos, err::EXPECTED_POS_INT);
+                break;
+            case OP_HOLD_LANE_CHECK:
+                if (!m_netlist)
+                    error(pos, err::LANE_HOLD_OUTSIDE_RUNTIME);
+                break;
+            case OP_HOLD:
+                sideEffect();
+                hold(frame, code.strings[instruction.a], instruction.b, pos);
+                break;
             }
         }
-        return std::monostate();
+        return Number(0);
     }
 
-    NodeReturnType Interpreter::visitCon(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    SymbolValueType *Interpreter::resolve(
+        Frame &frame, const bytecode::Binding &binding)
     {
-        if (ctx.inFunction)
-            error(node->pos, err::LOGIC_INSIDE_FUNCTION);
-        auto &value = std::get<ConValue>(node->value);
-
-        // get left item
-        auto left = visit(value.left, ctx);
-        // check left item is gate or array of gates
-        if (!std::holds_alternative<LogicGate *>(left) &&
-            !std::holds_alternative<std::vector<LogicGate> *>(left))
-            error(value.left->pos, err::OBJECT_TYPE_INCORRECT);
-        // get right item
-        auto right = visit(value.right, ctx);
-        // check right item is gate or array of gates
-        if (!std::holds_alternative<LogicGate *>(right) &&
-            !std::holds_alternative<std::vector<LogicGate> *>(right))
-            error(value.right->pos, err::OBJECT_TYPE_INCORRECT);
-        bool leftIsArray =
-            std::holds_alternative<std::vector<LogicGate> *>(left);
-        bool rightIsArray =
-            std::holds_alternative<std::vector<LogicGate> *>(right);
-        if (!leftIsArray && !rightIsArray)
-        {
-            auto leftGate = std::get<LogicGate *>(left);
-            auto rightGate = std::get<LogicGate *>(right);
-            rightGate->addDependency(leftGate);
-        }
-        else if (leftIsArray && rightIsArray)
-        {
-            auto leftArray = std::get<std::vector<LogicGate> *>(left);
-            auto rightArray = std::get<std::vector<LogicGate> *>(right);
-            if (leftArray->size() != rightArray->size())
-                error(node->pos, err::CONNECT_ARRAY_TO_DIFF_SIZED_ARRAY);
-            for (size_t i = 0; i < rightArray->size(); i++)
-                (*rightArray)[i].addDependency(&(*leftArray)[i]);
-        }
-        else
-        {
-            error(node->pos, err::CONNECT_ARRAY_TO_NOT_ARRAY);
-        }
-        return std::monostate();
+        for (uint32_t slot : binding.slots)
+            if (!std::holds_alternative<std::monostate>(frame.slots[slot]))
+                return &frame.slots[slot];
+        return lookup(frame, binding);
     }
 
-    NodeReturnType Interpreter::visitFor(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    SymbolValueType *Interpreter::lookup(
+        Frame &frame, const bytecode::Binding &binding)
     {
-        auto &value = std::get<ForValue>(node->value);
-
-        Number from = std::get<Number>(visit(value.from, ctx));
-        if (!from.holdsInt())
-            error(value.from->pos, err::RANGE_BOUND_MUST_BE_INTEGER);
-        Number to = std::get<Number>(visit(value.to, ctx));
-        if (!from.holdsInt())
-            error(value.to->pos, err::RANGE_BOUND_MUST_BE_INTEGER);
-        if (from.getInt() > to.getInt())
-            error(value.from->pos, err::LOWER_BOUND_GT_UPPER_BOUND);
-
-        Number var(from);
-
-        while (var.getInt() <= to.getInt())
+        // Look the name up in the symbol table once.
+        // (and again only if it wasn't found and symbols were added since)
+        // (speculative interpreters run in parallel and leave the cache alone)
+        SymbolTable *symbolTable = frame.symbolTable;
+        if (m_speculative)
+            return symbolTable->lookup(binding.name);
+        if (binding.table != symbolTable ||
+            (!binding.symbol &&
+             binding.numSymbols != symbolTable->numSymbols()))
         {
-            // child symbol table with variable as symbol
-            SymbolTable newSymbolTable(&ctx.symbolTable);
-            newSymbolTable.setSymbol(value.var.value, var);
-            Context newCtx(newSymbolTable, ctx.logic);
-            newCtx.copyCtxInfo(ctx);
-            newCtx.inLoop = true;
-
-            visit(value.block, newCtx); // execute body
-
-            if (newCtx.shouldBreak) // encountered break statement
-                break;
-            else if (newCtx.shouldReturn)
-            {
-                ctx.returnValue = newCtx.returnValue;
-                ctx.shouldReturn = true;
-                break;
-            }
-
-            var = Number(var.getInt() + 1); // increment variable
+            binding.table = symbolTable;
+            binding.symbol = symbolTable->lookup(binding.name);
+            binding.numSymbols = symbolTable->numSymbols();
         }
-
-        return std::monostate();
+        return binding.symbol;
     }
 
-    NodeReturnType Interpreter::visitWhile(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    std::string Interpreter::assign(
+        Frame &frame, const bytecode::Binding &binding, SymbolValueType value)
     {
-        auto &value = std::get<WhileValue>(node->value);
-
-        while (!std::get<Number>(visit(value.cond, ctx)).isZero())
-        {
-            // child symbol table with variable as symbol
-            SymbolTable newSymbolTable(&ctx.symbolTable);
-            Context newCtx(newSymbolTable, ctx.logic);
-            newCtx.copyCtxInfo(ctx);
-            newCtx.inLoop = true;
-
-            visit(value.block, newCtx); // execute body
-
-            if (newCtx.shouldBreak) // encountered break statement
-                break;
-            else if (newCtx.shouldReturn)
+        // assign to the closest definition of the name
+        SymbolValueType *symbol = nullptr;
+        for (uint32_t slot : binding.slots)
+            if (!std::holds_alternative<std::monostate>(frame.slots[slot]))
             {
-                ctx.returnValue = newCtx.returnValue;
-                ctx.shouldReturn = true;
+                symbol = &frame.slots[slot];
                 break;
             }
+        if (!symbol && (symbol = lookup(frame, binding)))
+            symbolWrite();
+        if (symbol)
+        {
+            // Make sure that symbol is modifiable
+            if (std::holds_alternative<ModuleDeclaration>(*symbol) ||
+                std::holds_alternative<FunctionDeclaration>(*symbol))
+                return err::REDECL(binding.name.str());
+            *symbol = std::move(value);
+            return err::NOERR;
         }
-
-        return std::monostate();
+        // or define it in the current scope
+        if (binding.local)
+            frame.slots[binding.slots.front()] = std::move(value);
+        else
+        {
+            symbolWrite();
+            frame.symbolTable->setSymbol(binding.name, std::move(value));
+        }
+        return err::NOERR;
     }
 
-    NodeReturnType Interpreter::visitBreak(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    Call Interpreter::beginBuild(
+        SymbolValueType *typeNameSymbol, Name typeName, Pos pos)
     {
-        if (!ctx.inLoop)
-            error(node->pos, err::BREAK_CONTINUE_OUTSIDE_LOOP);
-        ctx.shouldBreak = true;
-        return std::monostate();
+        // Check for circular construction
+        if (!buildStack.empty() &&
+            std::count(buildStack.begin(),
+                       buildStack.end(), typeName) > 0)
+            error(pos, err::CIRCULAR_CONSTRUCTION);
+        buildStack.push_back(typeName);
+
+        // Get module declaration
+        if (!typeNameSymbol)
+            error(pos, err::IDENTIFIER_UNDEFINED(typeName.str()));
+        if (!std::holds_alternative<ModuleDeclaration>(*typeNameSymbol))
+            error(pos, err::DOES_NOT_NAME_MODULE_TYPE);
+        auto &moduleDecl = std::get<ModuleDeclaration>(*typeNameSymbol);
+        return Call(moduleDecl.args, moduleDecl.body);
     }
 
-    NodeReturnType Interpreter::visitContinue(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    std::unique_ptr<Module> Interpreter::buildModule(
+        Frame &frame, Call &call, Pos pos)
     {
-        if (!ctx.inLoop)
-            error(node->pos, err::BREAK_CONTINUE_OUTSIDE_LOOP);
-        ctx.shouldContinue = true;
-        return std::monostate();
+        auto &arena = frame.logic.arena;
+        auto mod = std::make_unique<Module>(arena);
+        Frame buildFrame(*frame.symbolTable->firstAncestor(), *mod,
+                         m_frameStack, false, call.body->numSlots);
+        populateArgs(buildFrame, call, pos);
+
+        // Building a module the same way again gives the same module,
+        // as long as no symbols it could have read changed since.
+        auto key = callKey(call);
+        if (auto *temp = findTemplate(key))
+        {
+            auto gates = arena.copy(
+                *temp->arena, temp->first, temp->numGates,
+                temp->connectionsBegin, temp->connectionsEnd);
+            buildStack.pop_back();
+            return temp->module->relocated(arena, temp->first, gates);
+        }
+        if (m_threadPool && call.body->buildsModules)
+            prebuild(call, *buildFrame.symbolTable);
+
+        // run body
+        size_t first = arena.size();
+        size_t connectionsBegin = arena.connections.size();
+        size_t sideEffects = m_sideEffects;
+        size_t symbolWrites = m_symbolWrites;
+        execute(*call.body, buildFrame);
+        GateArray gates{(GateId)first, (uint32_t)(arena.size() - first)};
+        if (m_sideEffects == sideEffects && m_symbolWrites == symbolWrites &&
+            mod->sameOrder(*mod->relocated(arena, gates.first, gates)))
+            m_templates[key] = Template{
+                mod.get(), &arena, gates.first, gates.size,
+                connectionsBegin, arena.connections.size(), symbolWrites};
+        buildStack.pop_back();
+        return mod;
     }
 
-    NodeReturnType Interpreter::visitReturn(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    Interpreter::CallKey Interpreter::callKey(const Call &call)
     {
-        auto &value = std::get<ReturnValue>(node->value);
-        if (!ctx.inFunction)
-            error(node->pos, err::RETURN_OUTSIDE_FUNCTION);
-        ctx.shouldReturn = true;
-        ctx.returnValue = std::get<Number>(visit(value.expression, ctx));
-        return std::monostate();
+        std::vector<uint64_t> args;
+        for (auto argValues : {&call.argValues, &call.defaultValues})
+            for (Number number : *argValues)
+            {
+                uint32_t bits;
+                std::memcpy(&bits, &number.intVal, sizeof(bits));
+                args.push_back(((uint64_t)number.isInt << 32) | bits);
+            }
+        return std::make_pair(call.body, std::move(args));
     }
 
-    NodeReturnType Interpreter::visitIf(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    const Template *Interpreter::findTemplate(const CallKey &key) const
     {
-        auto &value = std::get<IfValue>(node->value);
-        size_t blockIndex = 0;
+        auto found = m_templates.find(key);
+        if (found != m_templates.end() &&
+            found->second.symbolWrites == m_symbolWrites)
+            return &found->second;
+        return m_parent ? m_parent->findTemplate(key) : nullptr;
+    }
 
-        // figure out the index of the block whose condition
-        // evaluates to true
-        for (; blockIndex < value.conds.size(); blockIndex++)
+    void Interpreter::prebuild(Call &call, SymbolTable &symbolTable)
+    {
+        // Find the modules the body builds before anything a speculative
+        // interpreter gives up on (such as accessing an item).
+        Interpreter discoverer(*this, true);
+        try
         {
-            auto condValue =
-                std::get<Number>(visit(value.conds[blockIndex], ctx));
-            if (!condValue.isZero()) // condition evaluates to true
-                break;
-        }
-        if (blockIndex == value.conds.size())
-        { // all conditions evaluated to false.
-            if (value.ifBlocks.size() > value.conds.size())
-            {
-                // there are more blocks than conditions.
-                // i.e. there's an else block - execute it.
-
-                // child symbol table to current one
-                SymbolTable newSymbolTable(&ctx.symbolTable);
-                Context newCtx(newSymbolTable, ctx.logic);
-                newCtx.copyCtxInfo(ctx);
-
-                // value.ifBlocks has an else block,
-                // therefore it isn't empty and value.ifBlocks.back()
-                // is defined behavior
-                visit(value.ifBlocks.back(), newCtx);
-                ctx.copyInfoToForward(newCtx);
-            }
+            Frame frame(symbolTable, *discoverer.m_globalModule,
+                        discoverer.m_frameStack, false, call.body->numSlots);
+            discoverer.populateArgs(frame, call, Pos());
+            discoverer.execute(*call.body, frame);
         }
-        else // one of the conditions evalutated to true
+        catch (...)
         {
-            // child symbol table to current one
-            SymbolTable newSymbolTable(&ctx.symbolTable);
-            Context newCtx(newSymbolTable, ctx.logic);
-            newCtx.copyCtxInfo(ctx);
-            visit(value.ifBlocks[blockIndex], newCtx);
-            ctx.copyInfoToForward(newCtx);
         }
 
-        return std::monostate();
-    }
-
-    NodeReturnType Interpreter::visitBlock(
-        const std::unique_ptr<Node> &node, Context &ctx)
-    {
-        auto &value = std::get<BlockValue>(node->value);
-        for (auto &field : value.fields)
+        // Build each of them once.
+        std::vector<Call> calls;
+        std::vector<CallKey> keys;
+        std::vector<Name> typeNames;
+        std::set<CallKey> seen;
+        auto &pending = discoverer.m_pendingBuilds;
+        for (auto &build : pending)
         {
-            visit(field, ctx);
-            if (ctx.shouldContinue ||
-                ctx.shouldBreak ||
-                ctx.shouldReturn)
-                break;
+            Call pendingCall(build.args, build.body);
+            pendingCall.argValues = build.argValues;
+            pendingCall.defaultValues = build.defaultValues;
+            auto key = callKey(pendingCall);
+            if (findTemplate(key) || !seen.insert(key).second)
+                continue;
+            calls.push_back(std::move(pendingCall));
+            keys.push_back(std::move(key));
+            typeNames.push_back(build.typeName);
         }
-        return std::monostate();
-    }
-
-    NodeReturnType Interpreter::visitFuncDecl(
-        const std::unique_ptr<Node> &node, Context &ctx)
-    {
-        auto &value = std::get<DeclValue>(node->value);
+        // (a single one is better built in order)
+        if (calls.size() < 2)
+            return;
+
+        // each in its own interpreter and arena
+        std::vector<std::unique_ptr<Interpreter>> builders(calls.size());
+        std::vector<std::unique_ptr<Module>> modules(calls.size());
+        m_threadPool->runTasks(calls.size(), [&](size_t i)
+                               {
+            builders[i].reset(new Interpreter(*this, false));
+            auto &builder = *builders[i];
+            Frame frame(symbolTable, *builder.m_globalModule,
+                        builder.m_frameStack);
+            builder.buildStack.push_back(typeNames[i]);
+            try
+            {
+                modules[i] = builder.buildModule(frame, calls[i], Pos());
+            }
+            catch (...)
+            {
+                modules[i].reset();
+            } });
 
-        auto args = parseArgs(ctx, value.args);
-        auto errmsg = ctx.symbolTable.setSymbol(
-            value.identifier.value,
-            FunctionDeclaration(args, std::move(value.body)));
-        if (errmsg != err::NOERR)
-            error(value.identifier.pos, errmsg);
-        return std::monostate();
+        // Keep the templates of the builds that succeeded.
+        for (size_t i = 0; i < calls.size(); i++)
+        {
+            auto &builder = *builders[i];
+            if (!modules[i] || !builder.m_templates.count(keys[i]))
+                continue;
+            for (auto &entry : builder.m_templates)
+                m_templates[entry.first] = entry.second;
+            m_prebuilt.push_back(std::move(builder.m_globalModule));
+            m_prebuilt.push_back(std::move(modules[i]));
+        }
     }
 
-    NodeReturnType Interpreter::visitFuncCall(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    Call Interpreter::beginCall(
+        SymbolValueType *funcDeclSymbol, Name name, Pos pos)
     {
-        auto &value = std::get<FuncCallValue>(node->value);
-        auto funcDeclSymbol =
-            ctx.symbolTable.lookup(value.identifier.value);
         if (!funcDeclSymbol)
-            error(value.identifier.pos,
-                  err::IDENTIFIER_UNDEFINED(value.identifier.value));
-        if (!std::holds_alternative<FunctionDeclaration>(
-                *funcDeclSymbol))
-            error(value.identifier.pos, err::DOES_NOT_NAME_FUNCTION);
+            error(pos, err::IDENTIFIER_UNDEFINED(name.str()));
+        if (!std::holds_alternative<FunctionDeclaration>(*funcDeclSymbol))
+            error(pos, err::DOES_NOT_NAME_FUNCTION);
         auto &funcDecl = std::get<FunctionDeclaration>(*funcDeclSymbol);
-
-        // Populate arguments in child symbolTable
-        SymbolTable newSymbolTable(ctx.symbolTable.firstAncestor());
-        populateArgs(ctx, newSymbolTable, funcDecl.args,
-                     value.args, value.identifier.pos);
-
-        Context newCtx(newSymbolTable, ctx.logic);
-        newCtx.inFunction = true;
-        visit(funcDecl.body, newCtx);
-        auto returnValue = newCtx.returnValue;
-        return returnValue;
+        return Call(funcDecl.args, funcDecl.body);
     }
 
-    NodeReturnType Interpreter::visitImport(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    Number Interpreter::callFunction(Frame &frame, Call &call, Pos pos)
     {
-        auto &value = std::get<LeafValue>(node->value);
-        auto strlit = value.token.value;
-
-        // get filename
-        std::string filename = strlit.substr(1, strlit.length() - 2);
-        // check if file already imported
-        if (!importedFiles.empty() &&
-            std::count(importedFiles.begin(),
-                       importedFiles.end(), filename) > 0)
-            return std::monostate();
-        // open file
-        importedFiles.push_back(filename); // record file was imported
-        std::fstream file;
-        file.open(filename, std::ios::in);
-        if (!file)
-            error(value.token.pos, err::FILE_NOT_FOUND(filename));
-        std::stringstream buf;
-        buf << file.rdbuf();
-        files.push_back(buf.str());
-        std::string &text = files.back();
-
-        if (!importStack.empty() &&
-            std::count(importStack.begin(),
-                       importStack.end(), filename) > 0)
-            error(value.token.pos, err::CIRCULAR_IMPORT);
-        importStack.push_back(filename);
-
-        try
+        // Populate arguments in the function's frame
+        Frame callFrame(*frame.symbolTable->firstAncestor(), frame.logic,
+                        m_frameStack, false, call.body->numSlots);
+        populateArgs(callFrame, call, pos);
+        if (!m_options.cacheResults)
+            return execute(*call.body, callFrame);
+
+        // Functions can't access items, so calling one with the same
+        // arguments again gives the same result, as long as it has no side
+        // effects and no symbols it could have read changed since.
+        auto key = callKey(call);
+        auto found = m_results.find(key);
+        if (found != m_results.end() &&
+            found->second.symbolWrites == m_symbolWrites)
         {
-            // Lex it
-            lexer::Lexer l(text, importedFiles.size() - 1);
-            auto tokens = l.lex();
-
-            // Parse it
-            parser::Parser p(tokens, importedFiles.size() - 1);
-            auto ast = p.parse();
-
-            // Interpret it
-            Context newCtx(
-                *ctx.symbolTable.firstAncestor(), ctx.logic);
-            visit(ast, newCtx);
+            m_resultHits++;
+            return found->second.result;
         }
-        catch (err::LexerParserException &e)
+        m_resultMisses++;
+
+        size_t sideEffects = m_sideEffects;
+        size_t symbolWrites = m_symbolWrites;
+        Number result = execute(*call.body, callFrame);
+        if (m_sideEffects != sideEffects || m_symbolWrites != symbolWrites)
+            return result;
+        // (calls made by the body may have dropped or added the entry)
+        found = m_results.find(key);
+        if (found != m_results.end())
+            found->second = CachedResult{result, symbolWrites};
+        else
         {
-            err::fatalErrorAbort(e.pos, filename, text, e.message);
+            if (m_results.size() == maxCachedResults)
+            {
+                m_results.erase(m_resultOrder.front());
+                m_resultOrder.pop_front();
+            }
+            m_resultOrder.push_back(
+                m_results.emplace(std::move(key),
+                                  CachedResult{result, symbolWrites})
+                    .first);
         }
-        catch (err::InterpreterException &e)
+        return result;
+    }
+
+    void Interpreter::populateArgs(Frame &frame, Call &call, Pos errorPos)
+    {
+        auto &argNames = call.args->argNames;
+        auto &params = call.body->params;
+        auto &bindings = call.body->bindings;
+
+        // make sure all non-default arguments have been provided
+        if (call.argValues.size() != argNames.size())
+            error(errorPos, err::WRONG_ARG_NUM(
+                                argNames.size(), call.argValues.size()));
+
+        // populate non default arguments
+        for (size_t i = 0; i < call.argValues.size(); i++)
         {
-            err::fatalErrorAbort(e.pos, e.filename, e.text, e.message);
+            auto errmsg = assign(
+                frame, bindings[params[i]], call.argValues[i]);
+            if (errmsg != err::NOERR)
+                error(call.argPositions[i], errmsg);
         }
 
-        importStack.pop_back();
-
-        return std::monostate();
+        // populate default arguments
+        for (size_t i = 0; i < call.defaultValues.size(); i++)
+        {
+            auto errmsg = assign(
+                frame, bindings[params[argNames.size() + i]],
+                call.defaultValues[i]);
+            if (errmsg != err::NOERR)
+                error(argNames.size() < call.argPositions.size()
+                          ? call.argPositions[argNames.size()]
+                          : errorPos,
+                      errmsg);
+        }
     }
 
-    NodeReturnType Interpreter::visitMod(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    void Interpreter::declare(
+        Frame &frame, const bytecode::Binding &binding,
+        SymbolValueType declaration, Pos pos)
     {
-        auto &value = std::get<DeclValue>(node->value);
-        auto errmsg = ctx.symbolTable.setSymbol(
-            value.identifier.value,
-            ModuleDeclaration(
-                parseArgs(ctx, value.args), std::move(value.body)));
+        auto errmsg = assign(frame, binding, std::move(declaration));
         if (errmsg != err::NOERR)
-            error(value.identifier.pos, errmsg);
-        return std::monostate();
+            error(pos, errmsg);
     }
 
-    NodeReturnType Interpreter::visitVarAssign(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    void Interpreter::accessMember(
+        Frame &frame, const bytecode::Segment &segment)
     {
-        auto &value = std::get<VarAssignValue>(node->value);
-        auto symbolValue =
-            std::get<Number>(visit(value.rhs, ctx));
-        if (value.lhs) // no need to assign if lhs is nullptr
+        // current module (the object is replaced by the member)
+        Object &object = frame.objects.back();
+        Module *currModule = std::get<Module *>(object);
+        auto &currIden = segment.name;
+        if (segment.indexed) // current identifier is indexed
         {
-            const auto &identifier = getIdenFromExpr(value.lhs);
-            auto errmsg =
-                ctx.symbolTable.setSymbol(identifier.value, symbolValue);
-            if (errmsg != err::NOERR)
-                error(identifier.pos, errmsg);
+            auto indexNumber = frame.pop();
+            if (!indexNumber.holdsInt())
+                error(segment.indexPos, err::INDEX_MUST_BE_INTEGER);
+            int index = indexNumber.getInt();
+
+            auto gateArray = currModule->gateArrays.find(currIden);
+            auto moduleArray = currModule->moduleArrays.find(currIden);
+            if (gateArray != currModule->gateArrays.end())
+            { // found gate array
+                if (!segment.last)
+                    error(segment.nextPos, err::NO_MEMBER_TO_ACCESS);
+
+                // Check if index is out of bounds
+                if (index < 0 || index >= (int)gateArray->second.size)
+                    error(segment.indexPos,
+                          err::INDEX_OUT_OF_BOUNDS(
+                              0, gateArray->second.size - 1, index));
+                object = Gate{gateArray->second.first + (GateId)index};
+            }
+            else if (moduleArray != currModule->moduleArrays.end())
+            {
+                if (index < 0 || index >= (int)moduleArray->second.size())
+                    error(segment.indexPos,
+                          err::INDEX_OUT_OF_BOUNDS(
+                              0, moduleArray->second.size() - 1, index));
+                object = moduleArray->second[index].get();
+            }
+            else
+                error(segment.identifierPos, err::MEMBER_ARRAY_UNDEFINED);
+            return;
         }
-        return std::monostate();
-    }
 
-    NodeReturnType Interpreter::visitPrint(
-        const std::unique_ptr<Node> &node, Context &ctx)
-    {
-        auto &value = std::get<PrintValue>(node->value);
-        if (value.strlit.type != TT_NULL) // print string literals
-        {
-            printStrlit(ctx, value.strlit, value.expressions);
+        // current identifier is not indexed
+        if (currModule->gates.count(currIden) > 0)
+        { // found gate
+            if (!segment.last)
+                error(segment.nextPos, err::NO_MEMBER_TO_ACCESS);
+            object = currModule->gates[currIden];
+        }
+        else if (currModule->gateArrays.count(currIden) > 0)
+        { // found gate array
+            if (!segment.last)
+                error(segment.nextPos, err::NO_MEMBER_TO_ACCESS);
+            object = currModule->gateArrays[currIden];
         }
-        else // print item
+        else if (currModule->modules.count(currIden) > 0)
+            object = currModule->modules[currIden].get();
+        else if (currModule->moduleArrays.count(currIden) > 0)
         {
-            if (ctx.inFunction && !ctx.inRuntime)
-                error(node->pos, err::LOGIC_INSIDE_FUNCTION);
-            auto itemValue = visit(value.item, ctx);
-            printObject(itemValue);
+            if (!segment.last)
+                error(segment.nextPos, err::NO_MEMBER_TO_ACCESS);
+            object = &currModule->moduleArrays[currIden];
         }
-        return std::monostate();
+        else
+            error(segment.identifierPos, err::MEMBER_UNDEFINED);
     }
 
-    NodeReturnType Interpreter::visitTick(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    void Interpreter::connect(Frame &frame, Pos pos)
     {
-        if (!ctx.inRuntime)
-            error(node->pos, err::TICK_HOLD_OUTSIDE_RUNTIME);
-        auto &value = std::get<TickValue>(node->value);
-
-        // Make sure the number of ticks is a positive integer.
-        Number tickNumber =
-            std::get<Number>(visit(value.expression, ctx));
-        if (!tickNumber.holdsInt() || tickNumber.getInt() <= 0)
-            error(value.expression->pos, err::EXPECTED_POS_INT);
-        size_t ticks = tickNumber.getInt();
-
-        // Update all gates
-        for (size_t i = 0; i < ticks; i++)
+        Object right = frame.objects.back();
+        frame.objects.pop_back();
+        Object left = frame.objects.back();
+        frame.objects.pop_back();
+
+        bool leftIsArray = std::holds_alternative<GateArray>(left);
+        bool rightIsArray = std::holds_alternative<GateArray>(right);
+        if (!leftIsArray && !rightIsArray)
         {
-            ctx.logic.generateNextValue();
-            ctx.logic.update();
+            auto leftGate = std::get<Gate>(left);
+            auto rightGate = std::get<Gate>(right);
+            frame.logic.arena.connect(leftGate.id, rightGate.id);
+        }
+        else if (leftIsArray && rightIsArray)
+        {
+            auto leftArray = std::get<GateArray>(left);
+            auto rightArray = std::get<GateArray>(right);
+            if (leftArray.size != rightArray.size)
+                error(pos, err::CONNECT_ARRAY_TO_DIFF_SIZED_ARRAY);
+            for (uint32_t i = 0; i < rightArray.size; i++)
+                frame.logic.arena.connect(
+                    leftArray.first + i, rightArray.first + i);
+        }
+        else
+        {
+            error(pos, err::CONNECT_ARRAY_TO_NOT_ARRAY);
         }
-        return std::monostate();
     }
 
-    NodeReturnType Interpreter::visitHold(
-        const std::unique_ptr<Node> &node, Context &ctx)
+    void Interpreter::hold(
+        Frame &frame, const std::string &holdAs, bool hasLane, Pos pos)
     {
-        auto &value = std::get<HoldValue>(node->value);
-
-        auto item = visit(value.item, ctx);
-
-        Number tickNumber = std::get<Number>(visit(value.holdFor, ctx));
-        if (!tickNumber.holdsInt() || tickNumber.getInt() <= 0)
-            error(value.holdFor->pos, err::EXPECTED_POS_INT);
-        int ticks = tickNumber.getInt();
-
-        if (std::holds_alternative<LogicGate *>(item)) // item is gate
+        uint64_t lanes = ~(uint64_t)0;
+        if (hasLane)
+            lanes = (uint64_t)1 << frame.pop().getInt();
+        int ticks = frame.pop().getInt();
+        Object item = frame.objects.back();
+        frame.objects.pop_back();
+
+        if (std::holds_alternative<Gate>(item)) // item is gate
         {
-            auto gate = std::get<LogicGate *>(item); // The gate
+            auto gate = std::get<Gate>(item); // The gate
 
             // Make sure size of object value is matches size of array
             // (in this case single object)
-            if (value.holdAs.value.size() != 1)
-                error(value.holdAs.pos,
-                      err::ITEM_VALUE_WRONG_SIZE(
-                          1, value.holdAs.value.size()));
+            if (holdAs.size() != 1)
+                error(pos, err::ITEM_VALUE_WRONG_SIZE(1, holdAs.size()));
 
             // Set value
-            if (value.holdAs.value[0] == '0')
-                gate->hold(false, ticks);
-            else if (value.holdAs.value[0] == '1')
-                gate->hold(true, ticks);
+            if (holdAs[0] == '0')
+                holdGate(frame, gate.id, false, ticks, lanes);
+            else if (holdAs[0] == '1')
+                holdGate(frame, gate.id, true, ticks, lanes);
             else
-                error(value.holdAs.pos, err::OBJECT_VALUE_ONE_OR_ZERO);
+                error(pos, err::OBJECT_VALUE_ONE_OR_ZERO);
         }
         else // item is array of gates
         {
-            auto gateArray =
-                std::get<std::vector<LogicGate> *>(item);
-
-            std::string objectInit = value.holdAs.value;
-            size_t objectInitSize = objectInit.size();
+            auto gateArray = std::get<GateArray>(item);
+            size_t objectInitSize = holdAs.size();
 
             // Make sure size of object value is matches size of array
-            if (objectInitSize != gateArray->size())
-                error(value.holdAs.pos,
-                      err::ITEM_VALUE_WRONG_SIZE(
-                          gateArray->size(), objectInitSize));
+            if (objectInitSize != gateArray.size)
+                error(pos, err::ITEM_VALUE_WRONG_SIZE(
+                               gateArray.size, objectInitSize));
 
             // Set value for each gate in array
             for (size_t i = 0; i < objectInitSize; i++)
             {
-                if (objectInit[objectInitSize - 1 - i] == '0')
-                    (*gateArray)[i].hold(false, ticks);
-                else if (objectInit[objectInitSize - 1 - i] == '1')
-                    (*gateArray)[i].hold(true, ticks);
+                if (holdAs[objectInitSize - 1 - i] == '0')
+                    holdGate(frame, gateArray.first + i, false, ticks, lanes);
+                else if (holdAs[objectInitSize - 1 - i] == '1')
+                    holdGate(frame, gateArray.first + i, true, ticks, lanes);
                 else
-                    error(value.holdAs.pos,
-                          err::OBJECT_VALUE_ONE_OR_ZERO);
+                    error(pos, err::OBJECT_VALUE_ONE_OR_ZERO);
             }
         }
-        return std::monostate();
     }
 
-    void Interpreter::printStrlit(
-        Context &ctx, Token strlit,
-        std::vector<std::unique_ptr<Node>> &expressions)
+    void Interpreter::import(
+        Frame &frame, const std::string &filename, Pos pos)
     {
-        std::string temp;
-        size_t numExpressions = expressions.size();
+        // check if file already imported
+        if (!importedFiles.empty() &&
+            std::count(importedFiles.begin(),
+                       importedFiles.end(), filename) > 0)
+            return;
+        // open file
+        importedFiles.push_back(filename); // record file was imported
+        auto source = Source::load(filename);
+        if (!source)
+            error(pos, err::FILE_NOT_FOUND(filename));
+        files.push_back(source);
+        std::string_view text = source->text();
 
-        // Basic escape sequqneces
+        if (!importStack.empty() &&
+            std::count(importStack.begin(),
+                       importStack.end(), filename) > 0)
+            error(pos, err::CIRCULAR_IMPORT);
+        importStack.push_back(filename);
 
-        // Go over each character in string.
-        // For bounds not inclusive of first and last characters
-        // To remove the outer quote (`"`) characters.
-        for (size_t i = 1; i < strlit.value.length() - 1; i++)
+        try
         {
-            // only try to parse escape sequqnce if current character
-            // is `\` and another character exists before the
-            // closing quote (`"`)
-            if (strlit.value[i] == '\\' &&
-                i + 1 < strlit.value.length() - 1)
-            {
-                if (strlit.value[i + 1] == 'n')
-                { // newline escape sequence
-                    temp += '\n';
-                    i++;
-                }
-                else if (strlit.value[i + 1] == 't')
-                { // tab escapre sequence
-                    temp += '\t';
-                    i++;
-                }
-                else
-                {
-                    // if no escape sequence recognized, the `\` will
-                    // be ommitted. this can be thought of as if
-                    // escaping something besides any of the valid
-                    // escape sequences will just yield what was escaped.
-                    // e.g. "\g" in the string will become just "g"
-                    // and "\\" in the string will become "\".
-                    temp += strlit.value[i + 1];
-                    i++;
-                }
-                continue;
-            }
-            if (strlit.value[i] == '$' &&
-                i + 1 < strlit.value.length() - 1)
-            {
-                // Try to build a number
-                // If the number is not empty, it will be treated as an
-                // index and the escape sequence will be replaced with
-                // the value of the expression with that index.
-                std::string number;
-                for (size_t j = i + 1; isdigit(strlit.value[j]); j++)
-                    number += strlit.value[j];
-                if (!number.empty()) // Escape sequence is index
-                {
-                    int index = std::stoi(number);
-                    if (index < 0 || (size_t)index > numExpressions - 1)
-                        error(
-                            Pos(strlit.pos.start + i,
-                                strlit.pos.start + i + number.size(),
-                                strlit.pos.fileIndex),
-                            err::INDEX_OUT_OF_BOUNDS(
-                                0, numExpressions - 1, index));
-                    temp +=
-                        std::get<Number>(
-                            visit(expressions[index], ctx))
-                            .repr();
-                    i += number.length();
-                    continue;
-                }
-            }
-            temp += strlit.value[i];
+            // Lex and parse it, compile it (freeing the tree) and run it
+            lexer::Lexer l(text, importedFiles.size() - 1,
+                           m_options.numThreads);
+            parser::Parser p(l, importedFiles.size() - 1);
+            m_units.push_back(bytecode::Compiler(p.parse()).compile());
+            execute(*m_units.back(),
+                    *frame.symbolTable->firstAncestor(), frame.logic);
+        }
+        catch (err::LexerParserException &e)
+        {
+            err::fatalErrorAbort(e.pos, filename, text, e.message);
+        }
+        catch (err::InterpreterException &e)
+        {
+            err::fatalErrorAbort(e.pos, e.filename, e.source->text(), e.message);
         }
-        std::cout << temp;
+
+        importStack.pop_back();
     }
 
-    void Interpreter::printObject(const NodeReturnType &object, size_t indent)
+    void Interpreter::printObject(
+        Frame &frame, const Object &object, size_t indent, size_t lane)
     {
         const std::string indentWith = "*** ";
         std::string indenter;
         for (size_t i = 0; i < indent; i++)
             indenter += indentWith;
-        if (std::holds_alternative<LogicGate *>(object))
+        if (std::holds_alternative<Gate>(object))
         { // item is gate
-            auto gate = std::get<LogicGate *>(object);
-            if (gate->active)
+            auto gate = std::get<Gate>(object);
+            if (gateActive(frame, gate.id, lane))
                 std::cout << "1";
             else
                 std::cout << "0";
         }
-        else if (std::holds_alternative<
-                     std::vector<LogicGate> *>(object))
+        else if (std::holds_alternative<GateArray>(object))
         { // item is gate array
-            auto gateArray =
-                std::get<std::vector<LogicGate> *>(object);
+            auto gateArray = std::get<GateArray>(object);
             // printed in reverse because gateArray[0] is the LSB
             // and therefore should be on the right.
-            for (auto it = std::crbegin(*gateArray);
-                 it != std::crend(*gateArray); it++)
+            for (GateId id = gateArray.first + gateArray.size;
+                 id-- > gateArray.first;)
             {
-                if ((*it).active)
+                if (gateActive(frame, id, lane))
                     std::cout << "1";
                 else
                     std::cout << "0";
@@ -986,8 +1132,8 @@ namespace snowlang::interpreter
                 std::cout << indenter << "Gates: " << std::endl;
                 for (auto &nameGate : mod->gates)
                 {
-                    std::cout << indenter << indentWith << nameGate.first << ": ";
-                    printObject(&nameGate.second);
+                    std::cout << indenter << indentWith << nameGate.first.str() << ": ";
+                    printObject(frame, nameGate.second, 0, lane);
                     std::cout << std::endl;
                 }
             }
@@ -998,8 +1144,8 @@ namespace snowlang::interpreter
                 std::cout << indenter << "Gate arrays: " << std::endl;
                 for (auto &nameGateArray : mod->gateArrays)
                 {
-                    std::cout << indenter << indentWith << nameGateArray.first << ": ";
-                    printObject(&nameGateArray.second);
+                    std::cout << indenter << indentWith << nameGateArray.first.str() << ": ";
+                    printObject(frame, nameGateArray.second, 0, lane);
                     std::cout << std::endl;
                 }
             }
@@ -1011,8 +1157,8 @@ namespace snowlang::interpreter
                 for (auto &nameModule : mod->modules)
                 {
                     std::cout << indenter << indentWith
-                              << nameModule.first << ": " << std::endl;
-                    printObject(nameModule.second.get(), indent + 1);
+                              << nameModule.first.str() << ": " << std::endl;
+                    printObject(frame, nameModule.second.get(), indent + 1, lane);
                     std::cout << std::endl;
                 }
             }
@@ -1024,8 +1170,9 @@ namespace snowlang::interpreter
                 for (auto &nameModuleArray : mod->moduleArrays)
                 {
                     std::cout << indenter << indentWith
-                              << nameModuleArray.first << ": " << std::endl;
-                    printObject(&nameModuleArray.second, indent + 1);
+                              << nameModuleArray.first.str() << ": " << std::endl;
+                    printObject(
+                        frame, &nameModuleArray.second, indent + 1, lane);
                     std::cout << std::endl;
                 }
             }
@@ -1042,106 +1189,43 @@ namespace snowlang::interpreter
             for (size_t i = 0; i < modArray->size(); i++)
             {
                 std::cout << indenter << i << ": " << std::endl;
-                printObject((*modArray)[i].get(), indent + 1);
+                printObject(frame, (*modArray)[i].get(), indent + 1, lane);
             }
             std::cout << indenter << "]" << std::endl;
         }
     }
 
-    Args Interpreter::parseArgs(
-        Context &ctx,
-        const std::vector<std::unique_ptr<Node>> &args)
+    bool Interpreter::gateActive(Frame &frame, GateId id, size_t lane)
     {
-        Args res;
-
-        bool assignment = false;
-        for (auto &arg : args)
-        {
-            auto &value = std::get<VarAssignValue>(arg->value);
-            auto &lhs = value.lhs;
-            auto &rhs = value.rhs;
-            if (lhs)
-                assignment = true;
-            if (assignment)
-            {
-                if (!lhs)
-                    error(arg->pos, err::REGULAR_ARG_AFTER_DEFAULT);
-
-                res.defaultArgs[getIdenFromExpr(lhs).value] =
-                    std::get<Number>(visit(rhs, ctx));
-            }
-            else
-                res.argNames.push_back(getIdenFromExpr(rhs).value);
-        }
-        return res;
+        if (m_netlist)
+            return m_netlist->value(id, lane);
+        return frame.logic.arena.active(id);
     }
 
-    void Interpreter::populateArgs(
-        Context &ctx, SymbolTable &symbolTable,
-        const Args &argsDecl,
-        const std::vector<std::unique_ptr<Node>> &args,
-        Pos errorPos)
+    void Interpreter::holdGate(
+        Frame &frame, GateId id, bool value, int holdFor, uint64_t lanes)
     {
-        // parse args into regular arguments and default argument overwrites
-        std::vector<Number> argValues;
-        std::unordered_map<std::string, Number> defaultArgs =
-            argsDecl.defaultArgs;
-        bool assignment = false;
-        for (auto &arg : args)
-        {
-            auto &value = std::get<VarAssignValue>(arg->value);
-            auto &lhs = value.lhs;
-            auto &rhs = value.rhs;
-            auto rhsVal = std::get<Number>(visit(rhs, ctx));
-            if (lhs)
-                assignment = true;
-            if (assignment)
-            {
-                if (!lhs)
-                    error(arg->pos, err::REGULAR_ARG_AFTER_DEFAULT);
-
-                auto iden = getIdenFromExpr(lhs).value;
-                if (argsDecl.defaultArgs.count(iden) == 0)
-                    error(arg->pos, err::NO_SUCH_DEFAULT_ARG(iden));
-                defaultArgs[iden] = rhsVal;
-            }
-            else
-                argValues.push_back(rhsVal);
-        }
-
-        // make sure all non-default arguments have been provided
-        if (argValues.size() != argsDecl.argNames.size())
-            error(errorPos, err::WRONG_ARG_NUM(
-                                argsDecl.argNames.size(),
-                                argValues.size()));
-
-        // populate non default arguments
-        for (size_t i = 0; i < argValues.size(); i++)
-        {
-            auto errmsg = symbolTable.setSymbol(
-                argsDecl.argNames[i], argValues[i]);
-            if (errmsg != err::NOERR)
-                error(args[i]->pos, errmsg);
-        }
-
-        // populate default arguments
+        if (m_netlist)
+            m_netlist->hold(id, value, holdFor, lanes);
+        else
+            frame.logic.arena.hold(id, value, holdFor);
+    }
 
-        size_t i = 0; // need index of key-value pair
-        for (auto &nameValue : defaultArgs)
-        {
-            auto errmsg = symbolTable.setSymbol(
-                nameValue.first, nameValue.second);
-            if (errmsg != err::NOERR)
-                error(args[argsDecl.argNames.size()]->pos, errmsg);
-            i++; // update index
-        }
+    size_t Interpreter::numLanes()
+    {
+        if (m_options.simMode == SM_BATCH)
+            return Netlist::batchLanes;
+        return 1;
     }
 
-    Token Interpreter::getIdenFromExpr(const std::unique_ptr<Node> &expr)
+    void Interpreter::checkLane(Frame &frame, Pos pos)
     {
-        if (expr->type != NT_LEAF ||
-            std::get<LeafValue>(expr->value).token.type != TT_IDEN)
-            error(expr->pos, err::EXPECTED_LVALUE);
-        return std::get<LeafValue>(expr->value).token;
+        Number laneNumber = frame.numbers.back();
+        if (!laneNumber.holdsInt())
+            error(pos, err::LANE_MUST_BE_INTEGER);
+        int laneIndex = laneNumber.getInt();
+        if (laneIndex < 0 || laneIndex >= (int)numLanes())
+            error(pos,
+                  err::INDEX_OUT_OF_BOUNDS(0, numLanes() - 1, laneIndex));
     }
-}
\ No newline at end of file
+}
@@ -2,155 +2,387 @@
 #include <iostream>
 #include <variant>
 #include <vector>
+#include <map>
+#include <deque>
 #include <memory>
 #include "node.hpp"
 #include "logic.hpp"
 #include "errorHandler.hpp"
-#include "logic.hpp"
+#include "netlist.hpp"
+#include "options.hpp"
+#include "threadPool.hpp"
 #include "symbol.hpp"
+#include "bytecode.hpp"
+#include "source.hpp"
 
 namespace snowlang::interpreter
 {
-    struct Context
+    // items: gates, gate arrays, modules and module arrays
+    using Object = std::variant<
+        std::monostate,
+        Gate,
+        GateArray,
+        Module *,
+        std::vector<std::unique_ptr<Module>> *>;
+
+    // call of a function (or construction of a module) whose arguments
+    // are being evaluated
+    struct Call
     {
-        SymbolTable &symbolTable;
-        Module &logic;
+        const Args *args;
+        const bytecode::Code *body;
 
-        // context information
-        bool inLoop{false};
-        bool inFunction{false};
-        bool shouldContinue{false};
-        bool shouldBreak{false};
-        bool shouldReturn{false};
-        Number returnValue{Number(0)};
-        bool inRuntime{false};
+        // regular arguments and default arguments (with overwrites)
+        std::vector<Number> argValues;
+        std::vector<Number> defaultValues;
+        // positions of all arguments given (for errors)
+        std::vector<Pos> argPositions;
+
+        Call(const Args &t_args, const bytecode::Code *t_body)
+            : args(&t_args), body(t_body),
+              defaultValues(t_args.defaultValues) {}
+    };
+
+    // module already built for some body and arguments.
+    // its gates (and the connections made while building it) are copied
+    // for further modules built the same way.
+    struct Template
+    {
+        // (copied with Module::relocated(), in its definition order)
+        const Module *module;
+        // arena holding its gates and connections
+        const GateArena *arena;
+        GateId first;
+        uint32_t numGates;
+        size_t connectionsBegin;
+        size_t connectionsEnd;
+        // writes to symbol tables before it was built
+        size_t symbolWrites;
+    };
+
+    // build of a module met ahead of time (see Interpreter::prebuild)
+    struct PendingBuild
+    {
+        Name typeName;
+        Args args;
+        const bytecode::Code *body;
+        std::vector<Number> argValues;
+        std::vector<Number> defaultValues;
+    };
+
+    // thrown when a speculative interpreter gives up
+    // (see Interpreter::prebuild)
+    struct SpeculationFailed
+    {
+    };
+
+    // Storage for the slots, numbers and objects of running frames.
+    // Frames take their slots from the top of the stack and push onto the
+    // shared number and object stacks, and give everything back when they
+    // end, so storage is reused rather than allocated for every call and
+    // build, and a frame is released in O(1).
+    // Slots come in chunks that never move.
+    class FrameStack
+    {
+    public:
+        std::vector<Number> numbers;
+        std::vector<Object> objects;
 
-        Context(SymbolTable &t_symbolTable, Module &t_logic)
-            : symbolTable(t_symbolTable), logic(t_logic) {}
+        // top of the stacks
+        struct Mark
+        {
+            size_t chunk;
+            size_t top;
+            size_t numNumbers;
+            size_t numObjects;
+        };
 
-        inline void copyCtxInfo(Context &other)
+        inline Mark mark() const
+        {
+            return Mark{m_chunk, m_top, numbers.size(), objects.size()};
+        }
+        // returns count undefined slots taken from the top of the stack
+        SymbolValueType *push(size_t count);
+        // gives back all slots, numbers and objects taken since mark
+        inline void release(Mark mark)
         {
-            inLoop = other.inLoop;
-            inFunction = other.inFunction;
-            inRuntime = other.inRuntime;
+            m_chunk = mark.chunk;
+            m_top = mark.top;
+            numbers.resize(mark.numNumbers);
+            objects.resize(mark.numObjects);
         }
 
-        inline void copyInfoToForward(Context &other)
+        // statistics
+        inline size_t numPushes() const
         {
-            shouldContinue = other.shouldContinue;
-            shouldBreak = other.shouldBreak;
-            shouldReturn = other.shouldReturn;
-            if (other.shouldReturn)
-                returnValue = other.returnValue;
+            return m_numPushes;
         }
+        inline size_t numChunks() const
+        {
+            return m_chunks.size();
+        }
+
+    private:
+        static const size_t chunkSize = 1024;
+
+        struct Chunk
+        {
+            std::unique_ptr<SymbolValueType[]> slots;
+            size_t size;
+        };
+        std::vector<Chunk> m_chunks;
+        size_t m_chunk{0};
+        size_t m_top{0};
+        size_t m_numPushes{0};
     };
 
-    using NodeReturnType = std::variant<
-        std::monostate,
-        Number,
-        ModuleDeclaration,
-        FunctionDeclaration,
-        LogicGate *,
-        std::vector<LogicGate> *,
-        Module *,
-        std::vector<std::unique_ptr<Module>> *>;
+    // state of running code (a script, the body of a module or function,
+    // or a runtime instruction)
+    struct Frame
+    {
+        // symbol table of the names that aren't in slots
+        SymbolTable *symbolTable;
+        Module &logic;
+        bool inRuntime{false};
+
+        // values of the code's slots (std::monostate if undefined), and
+        // stacks of numbers and objects (on top of those of the frames
+        // below), all taken from frameStack until the frame ends
+        FrameStack &frameStack;
+        FrameStack::Mark mark;
+        SymbolValueType *slots;
+        std::vector<Number> &numbers;
+        std::vector<Object> &objects;
+        std::vector<Call> calls;
+        // modules built but not yet defined
+        std::vector<std::unique_ptr<Module>> modules;
+        std::vector<std::vector<std::unique_ptr<Module>>> moduleArrays;
+        // arguments of the module or function being declared
+        Args params;
+        // text of the print statement being executed
+        std::string text;
+
+        Frame(SymbolTable &t_symbolTable, Module &t_logic,
+              FrameStack &t_frameStack, bool t_inRuntime = false,
+              size_t numSlots = 0)
+            : symbolTable(&t_symbolTable), logic(t_logic),
+              inRuntime(t_inRuntime), frameStack(t_frameStack),
+              mark(t_frameStack.mark()), slots(t_frameStack.push(numSlots)),
+              numbers(t_frameStack.numbers), objects(t_frameStack.objects) {}
+        Frame(const Frame &) = delete;
+        Frame &operator=(const Frame &) = delete;
+        ~Frame()
+        {
+            frameStack.release(mark);
+        }
+
+        inline Number pop()
+        {
+            Number number = numbers.back();
+            numbers.pop_back();
+            return number;
+        }
+    };
 
     class Interpreter
     {
     public:
-        Interpreter(std::unique_ptr<Node> t_ast, const std::string &filename, const std::string &text)
-            : m_ast(std::move(t_ast))
+        Interpreter(Ast t_ast, const std::string &filename,
+                    std::shared_ptr<const Source> source,
+                    const Options &t_options = Options())
+            : m_ast(std::move(t_ast)), m_options(t_options)
         {
             importedFiles.push_back(filename);
-            files.push_back(text);
+            files.push_back(std::move(source));
         }
+        // elaborates and runs the program
         void interpret();
 
+        // builds module 'Main' and its netlist
+        void elaborate();
+        // runs the 'runtime' function (or runtime instructions from the
+        // console if it's undefined). must be called after elaborate().
+        void run();
+
+        // gates of module 'Main' (after elaborate())
+        inline const GateArena &gates() const
+        {
+            return m_globalModule->arena;
+        }
+        inline Netlist &netlist()
+        {
+            return *m_netlist;
+        }
+        // function calls answered from the result cache and calls that
+        // weren't (for statistics)
+        inline size_t resultHits() const
+        {
+            return m_resultHits;
+        }
+        inline size_t resultMisses() const
+        {
+            return m_resultMisses;
+        }
+        // the main file followed by the files it imported so far
+        // (imports are run by elaborate())
+        inline const std::vector<std::shared_ptr<const Source>> &
+        sources() const
+        {
+            return files;
+        }
+        // storage of the frames run so far (for statistics)
+        inline const FrameStack &frameStack() const
+        {
+            return m_frameStack;
+        }
+
     private:
-        std::unique_ptr<Node> m_ast;
+        // speculative interpreter for building modules ahead of time.
+        // it reads the symbols and templates of parent, but gives up on
+        // any error, side effect or symbol write. if discovering, it only
+        // records the modules built (see prebuild).
+        Interpreter(const Interpreter &parent, bool t_discovering);
+
+        // parsed script (freed once it's compiled)
+        Ast m_ast;
+        Options m_options;
+
+        SymbolTable m_globalSymbolTable;
+        // global module (which owns the gate arena) and module 'Main'
+        std::unique_ptr<Module> m_globalModule;
+        std::unique_ptr<Module> m_mainModule;
+        FrameStack m_frameStack;
 
-        std::vector<std::string> buildStack;    // build call stack
+        // flattened circuit of module 'Main' (built after elaboration)
+        std::unique_ptr<Netlist> m_netlist;
+
+        // body and arguments of a call or build
+        using CallKey =
+            std::pair<const bytecode::Code *, std::vector<uint64_t>>;
+        // templates of modules whose bodies had no side effects
+        // (see buildModule)
+        std::map<CallKey, Template> m_templates;
+        // modules and arenas of templates built ahead of time
+        std::vector<std::unique_ptr<Module>> m_prebuilt;
+        // threads building modules ahead of time (if there are several)
+        std::unique_ptr<ThreadPool> m_threadPool;
+        // results of function calls that had no side effects
+        // (see callFunction), the oldest of which are dropped once there
+        // are maxCachedResults
+        static const size_t maxCachedResults = 4096;
+        struct CachedResult
+        {
+            Number result;
+            // writes to symbol tables before the call
+            size_t symbolWrites;
+        };
+        std::map<CallKey, CachedResult> m_results;
+        std::deque<std::map<CallKey, CachedResult>::iterator> m_resultOrder;
+        size_t m_resultHits{0};
+        size_t m_resultMisses{0};
+        // prints, holds, ticks and imports so far
+        size_t m_sideEffects{0};
+        // assignments to symbols in symbol tables so far
+        // (globals and runtime variables)
+        size_t m_symbolWrites{0};
+
+        std::vector<Name> buildStack;           // build call stack
         std::vector<std::string> importStack;   // import call stack
         std::vector<std::string> importedFiles; // filenames
-        std::vector<std::string> files;         // file contents
+        std::vector<std::shared_ptr<const Source>> files; // file contents
+
+        // set for speculative interpreters
+        const Interpreter *m_parent{nullptr};
+        bool m_speculative{false};
+        bool m_discovering{false};
+        // modules built while discovering
+        std::vector<PendingBuild> m_pendingBuilds;
 
         inline void error(Pos pos, const std::string &message)
         {
+            if (m_speculative)
+                throw SpeculationFailed();
             throw err::InterpreterException(
                 importedFiles[pos.fileIndex],
                 files[pos.fileIndex],
                 pos, message);
         }
 
-        std::unique_ptr<Module> buildModule(
-            Context &ctx,
-            std::string typeName, Pos pos,
-            const std::vector<std::unique_ptr<Node>> &args =
-                std::vector<std::unique_ptr<Node>>());
-
-        NodeReturnType visit(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitBinOp(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitUnOp(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitLeaf(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitItem(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitDefine(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitCon(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitFor(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitWhile(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitBreak(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitContinue(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitReturn(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitIf(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitBlock(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitFuncDecl(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitFuncCall(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitImport(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitMod(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitVarAssign(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitPrint(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitTick(
-            const std::unique_ptr<Node> &node, Context &ctx);
-        NodeReturnType visitHold(
-            const std::unique_ptr<Node> &node, Context &ctx);
-
-        // Assumes string's first and last characters are `"`.
-        void printStrlit(
-            Context &ctx, Token strlit,
-            std::vector<std::unique_ptr<Node>> &expressions);
-        void printObject(const NodeReturnType &object, size_t indent = 0);
-
-        Args parseArgs(
-            Context &ctx,
-            const std::vector<std::unique_ptr<Node>> &args);
-
-        void populateArgs(
-            Context &ctx, SymbolTable &symbolTable,
-            const Args &argsDecl,
-            const std::vector<std::unique_ptr<Node>> &args,
-            Pos errorPos);
-
-        // Throws error if expression is not just an identifier
-        // Otherwise returns the identifier as a Token
-        Token getIdenFromExpr(const std::unique_ptr<Node> &expr);
+        // compiled scripts (which own the bodies of the modules and
+        // functions they declare)
+        std::vector<std::unique_ptr<bytecode::Code>> m_units;
+
+        // runs code in frame until its end or a return statement.
+        // returns the return value (0 if there's none).
+        Number execute(const bytecode::Code &code, Frame &frame);
+        Number execute(const bytecode::Code &code,
+                       SymbolTable &symbolTable, Module &logic,
+                       bool inRuntime = false);
+
+        // returns the symbol a name refers to or nullptr if it's undefined
+        SymbolValueType *resolve(Frame &frame,
+                                 const bytecode::Binding &binding);
+        // same as resolve() but only looks in the frame's symbol table
+        SymbolValueType *lookup(Frame &frame,
+                                const bytecode::Binding &binding);
+        // returns error or err::NOERR if there's no error
+        std::string assign(Frame &frame, const bytecode::Binding &binding,
+                           SymbolValueType value);
+
+        // Looks up the module type and checks it's not being built already.
+        Call beginBuild(SymbolValueType *typeNameSymbol,
+                        Name typeName, Pos pos);
+        std::unique_ptr<Module> buildModule(Frame &frame, Call &call, Pos pos);
+        static CallKey callKey(const Call &call);
+        // template for key (nullptr if there's none or it's out of date)
+        const Template *findTemplate(const CallKey &key) const;
+        // Builds the modules the body of call builds (up to its first item
+        // access) in parallel, as templates, so running the body only copies
+        // them. Speculative builds that give up are simply built again in
+        // order, so errors and output are the same as without threads.
+        void prebuild(Call &call, SymbolTable &symbolTable);
+        // count side effects and symbol writes
+        // (which speculative interpreters give up on)
+        inline void sideEffect()
+        {
+            if (m_speculative)
+                throw SpeculationFailed();
+            m_sideEffects++;
+        }
+        inline void symbolWrite()
+        {
+            if (m_speculative)
+                throw SpeculationFailed();
+            m_symbolWrites++;
+        }
+        Call beginCall(SymbolValueType *funcDeclSymbol,
+                       Name name, Pos pos);
+        Number callFunction(Frame &frame, Call &call, Pos pos);
+        // populates the arguments of call in the frame running its body
+        void populateArgs(Frame &frame, Call &call, Pos errorPos);
+
+        void declare(Frame &frame, const bytecode::Binding &binding,
+                     SymbolValueType declaration, Pos pos);
+        void accessMember(Frame &frame, const bytecode::Segment &segment);
+        void connect(Frame &frame, Pos pos);
+        void hold(Frame &frame, const std::string &holdAs, bool hasLane,
+                  Pos pos);
+        void import(Frame &frame, const std::string &filename, Pos pos);
+
+        void printObject(
+            Frame &frame, const Object &object,
+            size_t indent = 0, size_t lane = 0);
+
+        // gate values and holds go through the netlist once it's built
+        // (and through the gate arena before)
+        bool gateActive(Frame &frame, GateId id, size_t lane = 0);
+        void holdGate(Frame &frame, GateId id, bool value, int holdFor,
+                      uint64_t lanes = ~(uint64_t)0);
+
+        // number of simulated lanes (more than 1 in batch mode)
+        size_t numLanes();
+        // Throws error if the number on top of the stack is not a
+        // valid lane.
+        void checkLane(Frame &frame, Pos pos);
     };
 }
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+#include <dlfcn.h>
+#include "jit.hpp"
+#include "netlist.hpp"
+
+namespace snowlang::jit
+{
+    namespace
+    {
+        // words of next values set by each generated function
+        // (very long functions take long to compile)
+        const size_t WORDS_PER_FUNCTION = 16;
+
+        // writes the expression of 64 gate values starting at the given
+        // gate (bits past the last gate are 0). if single, only the
+        // lowest bit of the expression is used.
+        void writeWord(std::ostringstream &source, size_t numWords,
+                       size_t start, bool single)
+        {
+            size_t word = start >> 6;
+            size_t shift = start & 63;
+            if (shift == 0)
+                source << "v[" << word << "]";
+            else if (single || word + 1 >= numWords)
+                source << "(v[" << word << "] >> " << shift << ")";
+            else
+                source << "(v[" << word << "] >> " << shift << " | v["
+                       << word + 1 << "] << " << 64 - shift << ")";
+        }
+
+        // writes the expression of the next values of gates
+        // [id, id + gates) (all in the same word) at their place in the
+        // word, where they are gates [done, done + gates) of a run
+        // starting at first
+        void writeGates(std::ostringstream &source, const Netlist &netlist,
+                        uint32_t first, const uint8_t *strides,
+                        uint32_t done, uint32_t gates)
+        {
+            size_t numWords = (netlist.numGates() + 63) / 64;
+            uint32_t id = first + done;
+            uint32_t begin = netlist.fanInOffsets[first];
+            uint32_t end = netlist.fanInOffsets[first + 1];
+            GateType type = netlist.types[first];
+            const char *op = " ^ ";
+            if (type == GT_OR || type == GT_NOR)
+                op = " | ";
+            else if (type == GT_AND || type == GT_NAND)
+                op = " & ";
+
+            source << "(";
+            if (type == GT_NOR || type == GT_NAND || type == GT_XNOR)
+                source << "~";
+            source << "(";
+            for (uint32_t i = begin; i < end; i++)
+            {
+                if (i > begin)
+                    source << op;
+                uint32_t dependency = netlist.fanIn[i];
+                if (strides && !strides[i - begin])
+                {
+                    // the same dependency for all gates
+                    source << "-(";
+                    writeWord(source, numWords, dependency, true);
+                    source << " & 1)";
+                }
+                else
+                    writeWord(source, numWords, dependency + done,
+                              gates == 1);
+            }
+            source << ")";
+            if (gates < 64)
+                source << " & 0x" << std::hex
+                       << (((uint64_t)1 << gates) - 1) << std::dec;
+            source << ")";
+            if (id & 63)
+                source << " << " << (id & 63);
+        }
+
+        // single quoted for the shell
+        std::string quote(const std::string &word)
+        {
+            std::string quoted = "'";
+            for (char c : word)
+            {
+                if (c == '\'')
+                    quoted += "'\\''";
+                else
+                    quoted += c;
+            }
+            return quoted + "'";
+        }
+
+        // the given words (split at whitespace), each quoted for the shell
+        std::string quoteWords(const std::string &words)
+        {
+            std::istringstream stream(words);
+            std::string word, quoted;
+            while (stream >> word)
+                quoted += " " + quote(word);
+            return quoted;
+        }
+    } // end of anonymous namespace
+
+    std::string generateSource(const Netlist &netlist)
+    {
+        size_t numGates = netlist.numGates();
+        size_t numWords = (numGates + 63) / 64;
+
+        // gate values are kept one bit per gate, as in Netlist, and runs
+        // of similar gates (see Netlist::buildRuns) are evaluated up to
+        // 64 gates at a time with bitwise operations on words.
+        // each word of next values is set by a single statement.
+        std::ostringstream statements;
+        std::vector<std::string> functions;
+        // word whose statement is being written
+        size_t word = 0;
+        auto endWord = [&]()
+        {
+            statements << ";\n";
+            word++;
+            if (word % WORDS_PER_FUNCTION == 0)
+            {
+                functions.push_back(statements.str());
+                statements.str("");
+            }
+            if (word < numWords)
+                statements << "    n[" << word << "] = 0";
+        };
+        if (numWords > 0)
+            statements << "    n[0] = 0";
+        for (auto &run : netlist.runs)
+        {
+            if (netlist.fanInOffsets[run.first] ==
+                netlist.fanInOffsets[run.first + 1]) // inactive
+                continue;
+            // (runs of a single gate have no strides)
+            const uint8_t *strides =
+                run.size > 1 ? &netlist.runStrides[run.strides] : nullptr;
+            uint32_t done = 0;
+            while (done < run.size)
+            {
+                uint32_t id = run.first + done;
+                uint32_t gates = std::min(64 - (id & 63), run.size - done);
+                while (word < (id >> 6))
+                    endWord();
+                statements << " |\n        ";
+                writeGates(statements, netlist, run.first, strides, done,
+                           gates);
+                done += gates;
+            }
+        }
+        while (word < numWords)
+            endWord();
+        if (numWords % WORDS_PER_FUNCTION != 0)
+            functions.push_back(statements.str());
+
+        std::ostringstream source;
+        source << "#include <stdint.h>\n";
+        for (size_t function = 0; function < functions.size(); function++)
+            source << "static void eval" << function
+                   << "(const uint64_t *restrict v, uint64_t *restrict n)\n"
+                   << "{\n"
+                   << functions[function] << "}\n";
+
+        // the values after the last tick end up in values if the number
+        // of ticks is even, and in next otherwise
+        source << "void snowlang_step(uint64_t *values, uint64_t *next,\n"
+               << "                   const uint64_t *held, uint64_t ticks)\n"
+               << "{\n"
+               << "    uint64_t *v = values, *n = next;\n"
+               << "    for (uint64_t t = 0; t < ticks; t++)\n"
+               << "    {\n";
+        for (size_t function = 0; function < functions.size(); function++)
+            source << "        eval" << function << "(v, n);\n";
+        source << "        if (held)\n"
+               << "            for (uint64_t i = 0; i < " << numWords
+               << "; i++)\n"
+               << "                n[i] = (n[i] & ~held[i]) | "
+               << "(v[i] & held[i]);\n"
+               << "        uint64_t *swap = v;\n"
+               << "        v = n;\n"
+               << "        n = swap;\n"
+               << "    }\n"
+               << "}\n";
+        return source.str();
+    }
+
+    CompiledCircuit::~CompiledCircuit()
+    {
+        if (m_library)
+            dlclose(m_library);
+    }
+
+    std::unique_ptr<CompiledCircuit> CompiledCircuit::compile(
+        const Netlist &netlist)
+    {
+        char directory[] = "/tmp/snowlang-jit-XXXXXX";
+        if (!mkdtemp(directory))
+            return nullptr;
+        std::string sourceFile = std::string(directory) + "/circuit.c";
+        std::string libraryFile = std::string(directory) + "/circuit.so";
+
+        std::ofstream file(sourceFile);
+        file << generateSource(netlist);
+        file.close();
+
+        // CC and CFLAGS may hold several words (such as "ccache cc"),
+        // which are passed to the shell as separate quoted arguments.
+        // the generated code is straight-line bitwise operations, which
+        // run as fast at -O1 as at -O2 while compiling in about half the
+        // time.
+        const char *compiler = std::getenv("CC");
+        const char *flags = std::getenv("CFLAGS");
+        std::string command =
+            quoteWords(compiler ? compiler : "cc") +
+            quoteWords(flags ? flags : "-O1") + " -shared -fPIC -o " +
+            quote(libraryFile) + " " + quote(sourceFile);
+        bool compiled = file && std::system(command.c_str()) == 0;
+
+        std::unique_ptr<CompiledCircuit> circuit;
+        void *library = nullptr;
+        if (compiled)
+            library = dlopen(libraryFile.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (library)
+        {
+            circuit.reset(new CompiledCircuit());
+            circuit->m_library = library;
+            circuit->step = (StepFunction)dlsym(library, "snowlang_step");
+            if (!circuit->step)
+                circuit = nullptr;
+        }
+
+        // the loaded library stays mapped after its file is removed
+        unlink(sourceFile.c_str());
+        unlink(libraryFile.c_str());
+        rmdir(directory);
+        return circuit;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace snowlang
+{
+    class Netlist;
+}
+
+namespace snowlang::jit
+{
+    // Generated function that runs the given number of ticks on the
+    // given gate values (one bit per gate, as in Netlist), using next
+    // for the values of the next tick. Gates with their bit set in held
+    // (unless it's null) keep their values. The values after the last
+    // tick are left in values if the number of ticks is even, and in
+    // next otherwise.
+    using StepFunction = void (*)(uint64_t *values, uint64_t *next,
+                                  const uint64_t *held, uint64_t ticks);
+
+    // Netlist compiled to native code through the system's C compiler
+    // (the CC environment variable, or 'cc').
+    class CompiledCircuit
+    {
+    public:
+        StepFunction step = nullptr;
+
+        ~CompiledCircuit();
+
+        // returns nullptr if compilation failed
+        static std::unique_ptr<CompiledCircuit> compile(
+            const Netlist &netlist);
+
+    private:
+        void *m_library = nullptr;
+
+        CompiledCircuit() = default;
+    };
+
+    // writes C source code of the given netlist's step function
+    std::string generateSource(const Netlist &netlist);
+}
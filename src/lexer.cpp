@@ -1,11 +1,146 @@
-#include <regex>
+#include <array>
+#include <cstring>
 
 #include "lexer.hpp"
 #include "errorHandler.hpp"
 #include "pos.hpp"
+#include "threadPool.hpp"
 
 namespace snowlang::lexer
 {
+    namespace
+    {
+        constexpr std::array<CharInfo, 256> charInfos()
+        {
+            std::array<CharInfo, 256> result{};
+            for (char c : {' ', '\t', '\n', '\v', '\f', '\r'})
+                result[c].charClass = CC_SPACE;
+            result['#'].charClass = CC_COMMENT;
+            for (int c = '0'; c <= '9'; c++)
+                result[c].charClass = CC_DIGIT;
+            for (int c = 'a'; c <= 'z'; c++)
+                result[c].charClass = CC_IDEN;
+            for (int c = 'A'; c <= 'Z'; c++)
+                result[c].charClass = CC_IDEN;
+            result['_'].charClass = CC_IDEN;
+            result['"'].charClass = CC_QUOTE;
+
+            const std::pair<char, TokenType> singles[] = {
+                {'{', TT_LBRACE}, {'}', TT_RBRACE},
+                {'[', TT_LBRACK}, {']', TT_RBRACK},
+                {'(', TT_LPAREN}, {')', TT_RPAREN},
+                {';', TT_SEMICOLON}, {',', TT_COMMA},
+                {'.', TT_PERIOD}, {'+', TT_PLUS}, {'-', TT_MINUS},
+                {'/', TT_DIV}, {'%', TT_REM}, {'|', TT_OR}, {'&', TT_AND},
+                {'*', TT_MULT}, {'=', TT_ASSIGN}, {'!', TT_NOT},
+                {'>', TT_GT}, {'<', TT_LT}};
+            for (auto &single : singles)
+            {
+                result[single.first].charClass = CC_OPERATOR;
+                result[single.first].type = single.second;
+            }
+            // for example '=' followed by '=' is TT_EQ
+            const std::pair<std::pair<char, char>, TokenType> doubles[] = {
+                {{'*', '*'}, TT_POW},
+                {{'=', '='}, TT_EQ},
+                {{'!', '='}, TT_NEQ},
+                {{'>', '='}, TT_GE},
+                {{'<', '='}, TT_LE}};
+            for (auto &pair : doubles)
+            {
+                result[pair.first.first].second = pair.first.second;
+                result[pair.first.first].secondType = pair.second;
+            }
+            return result;
+        }
+
+        // what each character can start (indexed by its unsigned value)
+        constexpr std::array<CharInfo, 256> CHARS = charInfos();
+
+        // texts shorter than this are lexed on one thread
+        const size_t MIN_PARALLEL_LENGTH = 256 * 1024;
+        // chunks per thread (so threads that finish early take more)
+        const size_t CHUNKS_PER_THREAD = 4;
+        // length of the text lexed per chunk when streaming in parallel
+        const size_t CHUNK_LENGTH = 16 * 1024;
+        // tokens lexed at a time on one thread
+        const size_t BATCH_SIZE = 512;
+
+        // offset just after the first newline in [from, end) that no
+        // token spans (or `end` if there's none). No token spans a
+        // newline but one escaped by a backslash, which may be in a
+        // string literal.
+        size_t lineEnd(std::string_view text, size_t from, size_t end)
+        {
+            while (from < end)
+            {
+                const void *found = memchr(
+                    text.data() + from, '\n', end - from);
+                if (!found)
+                    break;
+                size_t newline = (const char *)found - text.data();
+                // escaped if it follows an odd number of backslashes
+                size_t backslashes = 0;
+                while (backslashes < newline &&
+                       text[newline - backslashes - 1] == '\\')
+                    backslashes++;
+                if (backslashes % 2 == 0)
+                    return newline + 1;
+                from = newline + 1;
+            }
+            return end;
+        }
+
+        // first position from `pos` on whose character's class isn't in
+        // `classes` (a set of bits 1 << CharClass), or the end of the text
+        inline size_t skip(std::string_view text, size_t pos, unsigned classes)
+        {
+            const char *data = text.data();
+            const size_t length = text.length();
+            while (pos < length &&
+                   (classes >> CHARS[(unsigned char)data[pos]].charClass) & 1)
+                pos++;
+            return pos;
+        }
+    }
+
+    TokenType keyword(std::string_view iden)
+    {
+        // only compared with the keywords of its length
+        switch (iden.length())
+        {
+        case 2:
+            return iden == "if"   ? TT_IF
+                   : iden == "in" ? TT_IN
+                                  : TT_IDEN;
+        case 3:
+            return iden == "let"   ? TT_LET
+                   : iden == "con" ? TT_CON
+                   : iden == "for" ? TT_FOR
+                   : iden == "mod" ? TT_MOD
+                                   : TT_IDEN;
+        case 4:
+            return iden == "hold"   ? TT_HOLD
+                   : iden == "tick" ? TT_TICK
+                   : iden == "elif" ? TT_ELIF
+                   : iden == "else" ? TT_ELSE
+                                    : TT_IDEN;
+        case 5:
+            return iden == "print"   ? TT_PRINT
+                   : iden == "while" ? TT_WHILE
+                   : iden == "break" ? TT_BREAK
+                                     : TT_IDEN;
+        case 6:
+            return iden == "import"   ? TT_IMPORT
+                   : iden == "return" ? TT_RETURN
+                                      : TT_IDEN;
+        case 8:
+            return iden == "continue" ? TT_CONTINUE : TT_IDEN;
+        default:
+            return TT_IDEN;
+        }
+    }
+
     bool Lexer::advance(int positions)
     {
         pos += positions;
@@ -31,137 +166,205 @@ namespace snowlang::lexer
 
     void Lexer::generateNextToken()
     {
-        if (isspace(peek()))
+        const CharInfo &charInfo = CHARS[(unsigned char)text[pos]];
+        switch (charInfo.charClass)
         {
-            while (isspace(peek()))
-                advance();
+        case CC_SPACE: // (the whole run)
+            pos = skip(text, pos + 1, 1 << CC_SPACE);
             return;
-        }
-        else if (accept('#')) // comment
+        case CC_COMMENT:
         {
-            while (pos < text.length())
-            {
-                advance();
-                if (peek(-1) == '\n')
-                    break;
-            }
+            // up to and including the newline
+            const void *newline = memchr(
+                text.data() + pos, '\n', text.length() - pos);
+            pos = newline ? (const char *)newline - text.data() + 1
+                          : text.length();
+            return;
+        }
+        case CC_OPERATOR:
+            advance();
+            if (charInfo.second != '\0' && accept(charInfo.second))
+                tokens.emplace_back(
+                    charInfo.secondType, Pos(pos - 2, pos - 1, fileIndex));
+            else
+                tokens.emplace_back(charInfo.type, Pos(pos - 1, fileIndex));
             return;
+        case CC_DIGIT:
+            return generateNumber();
+        case CC_IDEN:
+            return generateIden();
+        case CC_QUOTE:
+            return generateStrlit();
+        default:
+            throw err::LexerParserException(
+                Pos(pos, fileIndex), err::COULD_NOT_MAKE_TOKEN);
         }
-        for (auto &charTypePair : charToToken)
+    }
+
+    std::vector<Token> Lexer::lex()
+    {
+        std::vector<Token> result;
+        // (a guess at the number of tokens, to skip most reallocations)
+        result.reserve((text.length() - pos) / 8 + 1);
+        // (the EOF token comes in a batch of its own)
+        while (current().type != TT_EOF)
         {
-            if (accept(charTypePair.first))
-            {
-                tokens.push_back(
-                    Token(charTypePair.second,
-                          Pos(pos - 1, fileIndex)));
-                return;
-            }
+            result.insert(result.end(), tokens.begin() + m_next, tokens.end());
+            m_next = tokens.size();
         }
-        for (auto &charsTypesPair : twoCharToToken)
+        result.push_back(current());
+        return result;
+    }
+
+    void Lexer::lexBatch()
+    {
+        tokens.clear();
+        m_next = 0;
+        // (a batch may hold no tokens, e.g. if it's all comments)
+        while (tokens.empty())
         {
-            auto chars = charsTypesPair.first;
-            auto types = charsTypesPair.second;
-            if (accept(chars.first))
+            if (m_error)
+                std::rethrow_exception(m_error);
+            if (pos >= text.length())
             {
-                if (accept(chars.second))
-                    tokens.push_back(Token(
-                        types.second,
-                        Pos(pos - 2, pos - 1, fileIndex)));
-                else
-                    tokens.push_back(Token(
-                        types.first, Pos(pos - 1, fileIndex)));
+                tokens.emplace_back(TT_EOF, Pos(pos, fileIndex));
                 return;
             }
+
+            if (numThreads > 1 && text.length() >= MIN_PARALLEL_LENGTH)
+            {
+                // the next window of whole lines
+                size_t end = pos + numThreads * CHUNKS_PER_THREAD *
+                                       CHUNK_LENGTH;
+                lexChunks(end < text.length()
+                              ? lineEnd(text, end, text.length())
+                              : text.length());
+                continue;
+            }
+
+            tokens.reserve(BATCH_SIZE);
+            try
+            {
+                while (tokens.size() < BATCH_SIZE && pos < text.length())
+                    generateNextToken();
+            }
+            catch (...)
+            {
+                // thrown once the tokens before it are used up
+                m_error = std::current_exception();
+            }
         }
-        // else (returned if any token found by now)
-        if (isdigit(peek()))
-            generateNumber();
-        else if (isalpha(peek()) || peek() == '_')
-            generateIden();
-        else if (peek() == '"')
-            generateStrlit();
-        else
-            throw err::LexerParserException(
-                Pos(pos, fileIndex), err::COULD_NOT_MAKE_TOKEN);
     }
 
-    std::vector<Token> Lexer::lex()
+    void Lexer::lexRest()
     {
+        // (a guess at the number of tokens, to skip most reallocations)
+        tokens.reserve((text.length() - pos) / 8 + 1);
         while (pos < text.length())
             generateNextToken();
-        tokens.push_back(Token(TT_EOF, Pos(pos, fileIndex)));
-        return tokens;
+    }
+
+    void Lexer::lexChunks(size_t end)
+    {
+        // Tokens don't span lines (comments end at newlines and string
+        // literals only contain escaped ones), so the text is split after
+        // newlines that aren't escaped and each chunk is lexed on its own.
+        std::vector<size_t> bounds{pos};
+        size_t numChunks = numThreads * CHUNKS_PER_THREAD;
+        for (size_t i = 1; i < numChunks; i++)
+        {
+            size_t target = pos + (end - pos) * i / numChunks;
+            if (target < bounds.back())
+                continue;
+            size_t bound = lineEnd(text, target, end);
+            if (bound == end)
+                break;
+            bounds.push_back(bound);
+        }
+        if (bounds.back() < end)
+            bounds.push_back(end);
+        numChunks = bounds.size() - 1;
+
+        std::vector<std::vector<Token>> chunkTokens(numChunks);
+        std::vector<std::exception_ptr> errors(numChunks);
+        if (!m_threadPool)
+            m_threadPool = std::make_unique<ThreadPool>(numThreads);
+        m_threadPool->runTasks(numChunks, [&](size_t i)
+                               {
+            // the chunk's lexer sees the text up to the chunk's end, so
+            // positions stay offsets into the whole text
+            Lexer chunk(text.substr(0, bounds[i + 1]), fileIndex);
+            chunk.pos = bounds[i];
+            try
+            {
+                chunk.lexRest();
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+            chunkTokens[i] = std::move(chunk.tokens); });
+
+        // the first error in the text is the one lexing it in one go
+        // would have stopped at
+        for (size_t i = 0; i < numChunks; i++)
+        {
+            tokens.insert(
+                tokens.end(), chunkTokens[i].begin(), chunkTokens[i].end());
+            if (errors[i])
+            {
+                m_error = errors[i];
+                return;
+            }
+        }
+        pos = end;
     }
 
     void Lexer::generateNumber()
     {
-        std::string num;
         bool isFloat = false;
         const int tokenStart = pos;
-        while (isdigit(peek()))
-        {
-            num += peek();
-            advance();
-        }
+        pos = skip(text, pos, 1 << CC_DIGIT);
         if (peek() == '.')
         {
-            num += '.';
             isFloat = true;
-            advance();
-        }
-        while (isdigit(peek()))
-        {
-            num += peek();
-            advance();
+            pos = skip(text, pos + 1, 1 << CC_DIGIT);
         }
         const int tokenEnd = pos - 1;
+        std::string_view num = text.substr(tokenStart, pos - tokenStart);
         if (isFloat)
-            tokens.push_back(Token(
-                TT_FLOAT,
-                Pos(tokenStart, tokenEnd, fileIndex),
-                num));
+            tokens.emplace_back(
+                TT_FLOAT, Pos(tokenStart, tokenEnd, fileIndex), num);
         else
-            tokens.push_back(Token(
-                TT_INT,
-                Pos(tokenStart, tokenEnd, fileIndex),
-                num));
+            tokens.emplace_back(
+                TT_INT, Pos(tokenStart, tokenEnd, fileIndex), num);
     }
     void Lexer::generateIden()
     {
-        std::string iden;
         const int tokenStart = pos;
-        while (isalpha(peek()) || peek() == '_' || isdigit(peek()))
-        {
-            // this function is only called if the character reached
-            // is alpha or _. here digits are also allowed.
-            // this means that identifiers cannot start with digits but can
-            // contain them.
-
-            iden += peek();
-            advance();
-        }
+        // this function is only called if the character reached
+        // is alpha or _. here digits are also allowed.
+        // this means that identifiers cannot start with digits but can
+        // contain them.
+        pos = skip(text, pos, 1 << CC_IDEN | 1 << CC_DIGIT);
         const int tokenEnd = pos - 1;
+        std::string_view iden = text.substr(tokenStart, pos - tokenStart);
 
         // check for keywords
-        for (auto &keywordTypePair : keywords)
-            if (iden == keywordTypePair.first) // iden is keyword
-            {
-                tokens.push_back(Token(
-                    keywordTypePair.second, // the type specified
-                    Pos(tokenStart, tokenEnd, fileIndex)));
-                return;
-            }
+        TokenType type = keyword(iden);
+        if (type != TT_IDEN) // iden is keyword
+        {
+            tokens.emplace_back(type, Pos(tokenStart, tokenEnd, fileIndex));
+            return;
+        }
 
         // identifier is not keyword - add it as an iden token.
-        tokens.push_back(Token(
-            TT_IDEN,
-            Pos(tokenStart, tokenEnd, fileIndex),
-            iden));
+        tokens.emplace_back(
+            Pos(tokenStart, tokenEnd, fileIndex), Name(iden));
     }
     void Lexer::generateStrlit()
     {
         // accept opening '""
-        std::string strlit("\"");
         const int tokenStart = pos;
         accept('"');
 
@@ -175,24 +378,18 @@ namespace snowlang::lexer
 
             // escape \""
             if (peek() == '\\')
-            {
                 advance();
-                strlit += "\\";
-                strlit += peek();
-            }
-            else
-                strlit += peek();
             advance();
         }
 
         // accept closing '"'
         advance();
         const int tokenEnd = pos - 1;
-        strlit += '"';
 
-        tokens.push_back(Token(
+        // (including the quotes)
+        tokens.emplace_back(
             TT_STRLIT, // string literal
             Pos(tokenStart, tokenEnd, fileIndex),
-            strlit));
+            text.substr(tokenStart, pos - tokenStart));
     }
 }
\ No newline at end of file
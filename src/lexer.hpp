@@ -1,78 +1,87 @@
 #pragma once
 
 #include <iostream>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <exception>
 #include "token.hpp"
+#include "threadPool.hpp"
 
 namespace snowlang::lexer
 {
-    // map to identify single character tokens
-    const std::unordered_map<char, TokenType> charToToken{
-        {'{', TT_LBRACE},
-        {'}', TT_RBRACE},
-        {'[', TT_LBRACK},
-        {']', TT_RBRACK},
-        {'(', TT_LPAREN},
-        {')', TT_RPAREN},
-        {';', TT_SEMICOLON},
-        {',', TT_COMMA},
-        {'.', TT_PERIOD},
-        {'+', TT_PLUS},
-        {'-', TT_MINUS},
-        {'/', TT_DIV},
-        {'%', TT_REM},
-        {'|', TT_OR},
-        {'&', TT_AND},
+    // what a character can start (see CHARS in lexer.cpp)
+    enum CharClass : uint8_t
+    {
+        CC_INVALID,
+        CC_SPACE,
+        CC_COMMENT, // `#` (up to the end of the line)
+        CC_OPERATOR, // one or two character token
+        CC_DIGIT,
+        CC_IDEN, // letter or `_`
+        CC_QUOTE
     };
 
-    // map to identify single or double character tokens
-    // for example if '=' is enountered then next character
-    // has to be checked. if it is also '=' then we have
-    // equality token (TT_EQ). If there's only one '='
-    // then we have an assignment token (TT_ASSIGN).
-    // the char pair represents the two characters.
-    // in our example '=' twice. The TokenType pair
-    // represents the two options for token types.
-    // in our example TT_ASSIGN followed by TT_EQ.
-    const std::vector<std::pair<
-        std::pair<char, char>, std::pair<TokenType, TokenType>>>
-        twoCharToToken{
-            {{'*', '*'}, {TT_MULT, TT_POW}},
-            {{'=', '='}, {TT_ASSIGN, TT_EQ}},
-            {{'!', '='}, {TT_NOT, TT_NEQ}},
-            {{'>', '='}, {TT_GT, TT_GE}},
-            {{'<', '='}, {TT_LT, TT_LE}}};
+    struct CharInfo
+    {
+        CharClass charClass{CC_INVALID};
+        // token of the character alone
+        TokenType type{TT_NULL};
+        // if the character may start a two character token (such as
+        // `==`), its second character and type (else '\0')
+        char second{'\0'};
+        TokenType secondType{TT_NULL};
+    };
 
-    // map to identify keywords
-    const std::unordered_map<std::string, TokenType> keywords{
-        {"import", TT_IMPORT},
-        {"mod", TT_MOD},
-        {"print", TT_PRINT},
-        {"tick", TT_TICK},
-        {"hold", TT_HOLD},
-        {"let", TT_LET},
-        {"con", TT_CON},
-        {"if", TT_IF},
-        {"elif", TT_ELIF},
-        {"else", TT_ELSE},
-        {"for", TT_FOR},
-        {"in", TT_IN},
-        {"while", TT_WHILE},
-        {"break", TT_BREAK},
-        {"continue", TT_CONTINUE},
-        {"return", TT_RETURN}};
+    // keyword type of an identifier (TT_IDEN if it isn't one)
+    TokenType keyword(std::string_view iden);
 
+    // Stream of the tokens of a text, lexed a batch at a time as the
+    // parser asks for them (so the tokens of a large text are never all
+    // in memory at once).
     class Lexer
     {
     public:
-        Lexer(const std::string &t_text, size_t t_fileIndex = 0)
-            : text(t_text), fileIndex(t_fileIndex) {}
+        // the text must outlive the tokens (which refer to it).
+        // large texts are lexed on numThreads threads.
+        Lexer(std::string_view t_text, size_t t_fileIndex = 0,
+              size_t t_numThreads = 1)
+            : text(t_text), fileIndex(t_fileIndex),
+              numThreads(t_numThreads) {}
+
+        // token at the front of the stream (TT_EOF once the text is
+        // used up). errors are thrown once the token they stop lexing
+        // at is reached.
+        inline const Token &current()
+        {
+            if (m_next == tokens.size())
+                lexBatch();
+            return tokens[m_next];
+        }
+        // moves on to the next token
+        inline void next() { m_next++; }
+        // the rest of the stream (up to and including TT_EOF)
         std::vector<Token> lex();
 
     private:
-        const std::string &text;
+        std::string_view text;
         const size_t fileIndex = 0;
+        const size_t numThreads = 1;
         size_t pos = 0;
+        // current batch (the stream continues at tokens[m_next])
         std::vector<Token> tokens;
+        size_t m_next = 0;
+        // error lexing the next batch stopped at
+        std::exception_ptr m_error;
+        std::unique_ptr<ThreadPool> m_threadPool;
+
+        // replaces the batch with the next tokens of the text
+        void lexBatch();
+        // lexes the rest of the text (without adding the EOF token)
+        void lexRest();
+        // lexes the text up to `end` in chunks of whole lines in parallel
+        void lexChunks(size_t end);
         void generateNextToken();
         bool advance(int positions = 1);
         bool accept(char c);
@@ -2,107 +2,133 @@
 
 namespace snowlang
 {
-    void LogicGate::update()
+    Gate GateArena::add(GateType type)
     {
-        if (m_holdFor > 0)
+        return Gate{add(type, 1).first};
+    }
+
+    GateArray GateArena::add(GateType type, uint32_t count)
+    {
+        GateArray gates{(GateId)m_size, count};
+        reserve(m_size + count);
+        for (GateId id = gates.first; id < gates.first + count; id++)
         {
-            m_holdFor--;
-            if (m_holdFor > 0)
-                return;
+            Chunk &chunk = slot(id);
+            chunk.types[offset(id)] = type;
+            setActive(id, false);
         }
-        active = m_nextValue;
+        m_size += count;
+        return gates;
     }
 
-    void LogicGate::generateNextValue()
+    GateArray GateArena::copy(
+        const GateArena &source, GateId first, uint32_t count,
+        size_t begin, size_t end)
     {
-        // default behavior if no gates connected
-        if (m_dependencies.size() == 0)
+        GateArray gates{(GateId)m_size, count};
+        reserve(m_size + count);
+        for (uint32_t i = 0; i < count; i++)
         {
-            m_nextValue = false;
-            return;
+            GateId id = gates.first + i;
+            Chunk &chunk = slot(id);
+            chunk.types[offset(id)] = source.type(first + i);
+            setActive(id, false);
         }
+        m_size += count;
 
-        size_t activeGates = 0;
-        for (auto &gate : m_dependencies)
-            if (gate->active)
-                activeGates++;
-        if (type == GT_OR)
-            m_nextValue = (activeGates > 0);
-        else if (type == GT_AND)
-            m_nextValue = (activeGates == m_dependencies.size());
-        else if (type == GT_XOR)
-            m_nextValue = (activeGates % 2 == 1);
-        else if (type == GT_NOR)
-            m_nextValue = (activeGates == 0);
-        else if (type == GT_NAND)
-            m_nextValue = (activeGates < m_dependencies.size());
-        else if (type == GT_XNOR)
-            m_nextValue = (activeGates % 2 == 0);
+        connections.reserve(connections.size() + (end - begin));
+        for (size_t i = begin; i < end; i++)
+        {
+            Connection connection = source.connections[i];
+            connections.push_back(Connection{
+                connection.from - first + gates.first,
+                connection.to - first + gates.first});
+        }
+        return gates;
     }
 
-    void Module::generateNextValue()
+    void GateArena::reserve(size_t numGates)
     {
-        for (auto &gate : gates)
-            gate.second.generateNextValue();
-        for (auto &gateArray : gateArrays)
-            for (auto &gate : gateArray.second)
-                gate.generateNextValue();
-        for (auto &mod : modules)
-            mod.second->generateNextValue();
-        for (auto &modArray : moduleArrays)
-            for (auto &mod : modArray.second)
-                mod->generateNextValue();
+        while (m_chunks.size() * chunkSize < numGates)
+            m_chunks.push_back(std::make_unique<Chunk>());
     }
 
-    void Module::update()
+    bool Module::alreadyDefined(Name identifier)
     {
-        for (auto &gate : gates)
-            gate.second.update();
-        for (auto &gateArray : gateArrays)
-            for (auto &gate : gateArray.second)
-                gate.update();
-        for (auto &mod : modules)
-            mod.second->update();
-        for (auto &modArray : moduleArrays)
-            for (auto &mod : modArray.second)
-                mod->update();
+        return (gates.count(identifier) +
+                gateArrays.count(identifier) +
+                modules.count(identifier) +
+                moduleArrays.count(identifier)) > 0;
     }
 
-    size_t Module::numGates()
+    template <typename Map>
+    static bool sameKeys(const Map &left, const Map &right)
     {
-        size_t num = 0;
-        num += gates.size();
-        for (auto &gateArray : gateArrays)
-            num += gateArray.second.size();
-        for (auto &mod : modules)
-            num += mod.second->numGates();
-        for (auto &modArray : moduleArrays)
-            for (auto &mod : modArray.second)
-                num += mod->numGates();
-        return num;
+        if (left.size() != right.size())
+            return false;
+        auto rightEntry = right.begin();
+        for (auto &leftEntry : left)
+        {
+            if (leftEntry.first != rightEntry->first)
+                return false;
+            rightEntry++;
+        }
+        return true;
     }
 
-    size_t Module::numConnections()
+    std::unique_ptr<Module> Module::relocated(
+        GateArena &target, GateId from, GateArray to) const
     {
-        size_t num = 0;
-        for (auto &gate : gates)
-            num += gate.second.numConnected();
-        for (auto &gateArray : gateArrays)
-            for (auto &gate : gateArray.second)
-                num += gate.numConnected();
-        for (auto &mod : modules)
-            num += mod.second->numConnections();
-        for (auto &modArray : moduleArrays)
-            for (auto &mod : modArray.second)
-                num += mod->numConnections();
-        return num;
+        // Members are printed in the order their maps are iterated, so the
+        // copy defines them in the order the module did rather than in the
+        // order of its maps.
+        auto copy = std::make_unique<Module>(target);
+        copy->definitionOrder = definitionOrder;
+        for (Name name : definitionOrder)
+        {
+            auto gate = gates.find(name);
+            auto gateArray = gateArrays.find(name);
+            auto module = modules.find(name);
+            auto moduleArray = moduleArrays.find(name);
+            if (gate != gates.end())
+                copy->gates.emplace(
+                    name, Gate{gate->second.id - from + to.first});
+            else if (gateArray != gateArrays.end())
+                copy->gateArrays.emplace(
+                    name, GateArray{gateArray->second.first - from + to.first,
+                                    gateArray->second.size});
+            else if (module != modules.end())
+                copy->modules.emplace(
+                    name, module->second->relocated(target, from, to));
+            else if (moduleArray != moduleArrays.end())
+            {
+                std::vector<std::unique_ptr<Module>> copies;
+                copies.reserve(moduleArray->second.size());
+                for (auto &element : moduleArray->second)
+                    copies.push_back(element->relocated(target, from, to));
+                copy->moduleArrays.emplace(name, std::move(copies));
+            }
+        }
+        return copy;
     }
 
-    bool Module::alreadyDefined(const std::string &identifier)
+    bool Module::sameOrder(const Module &other) const
     {
-        return (gates.count(identifier) +
-                gateArrays.count(identifier) +
-                modules.count(identifier) +
-                moduleArrays.count(identifier)) > 0;
+        if (!sameKeys(gates, other.gates) ||
+            !sameKeys(gateArrays, other.gateArrays) ||
+            !sameKeys(modules, other.modules) ||
+            !sameKeys(moduleArrays, other.moduleArrays))
+            return false;
+        for (auto &entry : modules)
+            if (!entry.second->sameOrder(*other.modules.at(entry.first)))
+                return false;
+        for (auto &entry : moduleArrays)
+        {
+            auto &otherArray = other.moduleArrays.at(entry.first);
+            for (size_t i = 0; i < entry.second.size(); i++)
+                if (!entry.second[i]->sameOrder(*otherArray[i]))
+                    return false;
+        }
+        return true;
     }
 }
@@ -1,15 +1,17 @@
 #pragma once
 
 #include <iostream>
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <functional>
 #include <unordered_map>
+#include "name.hpp"
 
 namespace snowlang
 {
 
-    enum GateType
+    enum GateType : uint8_t
     {
         GT_NULL,
         GT_OR,   // any dependency is active
@@ -20,68 +22,179 @@ namespace snowlang
         GT_XNOR  // an even number of dependencies are active
     };
 
-    class LogicGate
+    // output of a gate of the given type given how many of its
+    // dependencies are active (a gate with no dependencies is inactive)
+    inline bool gateOutput(
+        GateType type, size_t activeGates, size_t numDependencies)
+    {
+        if (numDependencies == 0)
+            return false;
+        if (type == GT_OR)
+            return activeGates > 0;
+        else if (type == GT_AND)
+            return activeGates == numDependencies;
+        else if (type == GT_XOR)
+            return activeGates % 2 == 1;
+        else if (type == GT_NOR)
+            return activeGates == 0;
+        else if (type == GT_NAND)
+            return activeGates < numDependencies;
+        else if (type == GT_XNOR)
+            return activeGates % 2 == 0;
+        return false;
+    }
+
+    // index of a gate in the gate arena of its module tree
+    using GateId = uint32_t;
+
+    // a single gate
+    struct Gate
+    {
+        GateId id;
+    };
+
+    // a gate array (gates first up to (not including) first + size)
+    struct GateArray
+    {
+        GateId first;
+        uint32_t size;
+    };
+
+    // Storage for all gates of a module tree.
+    // Gates are identified by 32-bit ids and stored in fixed-size chunks,
+    // so adding gates never moves existing ones. The dependencies of all
+    // gates are kept in one pool of connections (in the order they were
+    // made).
+    class GateArena
     {
     public:
-        GateType type;
-        bool active = false;
-
-        LogicGate(GateType t_type)
-            : type(t_type) {}
-        LogicGate() = default;
-        void generateNextValue();
-        void update();
-        inline void addDependency(LogicGate *dependency)
+        struct Connection
+        {
+            GateId from;
+            GateId to;
+        };
+
+        static const size_t chunkBits = 12;
+        static const size_t chunkSize = (size_t)1 << chunkBits;
+
+        // gate 'to' depends on gate 'from' for every connection
+        std::vector<Connection> connections;
+        // ticks left to hold for held gates (before simulation starts)
+        std::unordered_map<GateId, int> holds;
+
+        Gate add(GateType type);
+        GateArray add(GateType type, uint32_t count);
+
+        // appends copies of the gates first up to (not including)
+        // first + count of source (which may be this arena) and of the
+        // connections begin up to end between them.
+        // the copies are inactive and not held.
+        GateArray copy(const GateArena &source, GateId first, uint32_t count,
+                       size_t begin, size_t end);
+
+        // allocates storage for the given number of gates in advance
+        void reserve(size_t numGates);
+
+        inline GateType type(GateId id) const
+        {
+            return slot(id).types[offset(id)];
+        }
+        // value of a gate (before simulation starts)
+        inline bool active(GateId id) const
         {
-            m_dependencies.push_back(dependency);
+            return (slot(id).active[offset(id) >> 6] >> (id & 63)) & 1;
         }
-        inline void hold(bool value, int holdFor)
+        inline void setActive(GateId id, bool value)
         {
-            active = value;
-            m_holdFor = holdFor;
+            uint64_t &word = slot(id).active[offset(id) >> 6];
+            if (value)
+                word |= (uint64_t)1 << (id & 63);
+            else
+                word &= ~((uint64_t)1 << (id & 63));
         }
-        inline size_t numConnected()
+
+        inline void connect(GateId from, GateId to)
+        {
+            connections.push_back(Connection{from, to});
+        }
+        inline void hold(GateId id, bool value, int holdFor)
+        {
+            setActive(id, value);
+            holds[id] = holdFor;
+        }
+        inline size_t size() const
         {
-            return m_dependencies.size();
+            return m_size;
         }
 
     private:
-        std::vector<LogicGate *> m_dependencies;
-        bool m_nextValue = false;
-        int m_holdFor = 0;
+        struct Chunk
+        {
+            GateType types[chunkSize];
+            uint64_t active[chunkSize / 64] = {};
+        };
+        std::vector<std::unique_ptr<Chunk>> m_chunks;
+        size_t m_size = 0;
+
+        static inline size_t offset(GateId id)
+        {
+            return id & (chunkSize - 1);
+        }
+        inline Chunk &slot(GateId id)
+        {
+            return *m_chunks[id >> chunkBits];
+        }
+        inline const Chunk &slot(GateId id) const
+        {
+            return *m_chunks[id >> chunkBits];
+        }
     };
 
     class Module
     {
+    private:
+        std::unique_ptr<GateArena> m_ownedArena;
+
     public:
+        // gates of the module tree (owned by the top level module)
+        GateArena &arena;
+
+        // top level module
+        Module()
+            : m_ownedArena(std::make_unique<GateArena>()),
+              arena(*m_ownedArena) {}
+        // submodule with gates in the given arena
+        explicit Module(GateArena &t_arena)
+            : arena(t_arena) {}
+
         // maps name to gate (representing singular gates)
-        std::unordered_map<std::string, LogicGate> gates;
+        std::unordered_map<Name, Gate> gates;
 
-        // maps name to gate vector (representing gate arrays)
-        std::unordered_map<
-            std::string,
-            std::vector<LogicGate>>
-            gateArrays;
+        // maps name to gate range (representing gate arrays)
+        std::unordered_map<Name, GateArray> gateArrays;
 
         // maps module name to (owned) module pointer
         // (representing single modules)
-        std::unordered_map<
-            std::string,
-            std::unique_ptr<Module>>
-            modules;
+        std::unordered_map<Name, std::unique_ptr<Module>> modules;
 
         // maps name to vector of (owned) module pointers
         // (representing module arrays)
-        std::unordered_map<
-            std::string,
-            std::vector<std::unique_ptr<Module>>>
+        std::unordered_map<Name, std::vector<std::unique_ptr<Module>>>
             moduleArrays;
 
-        void generateNextValue();
-        void update();
-        size_t numGates();
-        size_t numConnections();
+        // names of the members above in the order they were defined
+        // (the copies made by relocated() define them in the same order)
+        std::vector<Name> definitionOrder;
+
+        bool alreadyDefined(Name identifier);
 
-        bool alreadyDefined(const std::string &identifier);
+        // copy of the module in arena target for gates copied from
+        // `from` to `to` (see GateArena::copy)
+        std::unique_ptr<Module> relocated(
+            GateArena &target, GateId from, GateArray to) const;
+        // whether the members of both modules (and of their submodules)
+        // are iterated in the same order (relocated() defines them in the
+        // same order, which doesn't promise that)
+        bool sameOrder(const Module &other) const;
     };
 }
@@ -1,5 +1,5 @@
 #include <iostream>
-#include <fstream>
+#include <charconv>
 
 #include "lexer.hpp"
 #include "token.hpp"
@@ -7,40 +7,84 @@
 #include "node.hpp"
 #include "errorHandler.hpp"
 #include "interpreter.hpp"
+#include "options.hpp"
+#include "source.hpp"
 
 using namespace std;
 using namespace snowlang;
 
-int main(int argc, char *argv[])
+namespace
 {
-    if (argc < 2)
+    void usageAbort(const string &message)
     {
-        cout << "Missing argument. Program terminated." << endl;
+        cout << message << endl;
+        cout << "Usage: snowlang [--sim=sweep|event|word|batch|jit|settle] [--threads=n] [--no-cache] <file>" << endl;
         exit(1);
     }
-    string filename = argv[1];
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    string filename;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--sim=sweep")
+            options.simMode = SM_SWEEP;
+        else if (arg == "--sim=event")
+            options.simMode = SM_EVENT;
+        else if (arg == "--sim=word")
+            options.simMode = SM_WORD;
+        else if (arg == "--sim=batch")
+            options.simMode = SM_BATCH;
+        else if (arg == "--sim=jit")
+            options.simMode = SM_JIT;
+        else if (arg == "--sim=settle")
+            options.simMode = SM_SETTLE;
+        else if (arg.rfind("--threads=", 0) == 0)
+        {
+            string value = arg.substr(10);
+            size_t numThreads = 0;
+            auto parsed = from_chars(value.data(), value.data() + value.size(),
+                                     numThreads);
+            if (parsed.ec != errc() ||
+                parsed.ptr != value.data() + value.size() ||
+                numThreads < 1 || numThreads > MAX_THREADS)
+                usageAbort("Expected a number of threads from 1 to " +
+                           to_string(MAX_THREADS) + ". Program terminated.");
+            options.numThreads = numThreads;
+        }
+        else if (arg == "--no-cache")
+            options.cacheResults = false;
+        else if (arg.rfind("--", 0) == 0)
+            usageAbort("Unknown option '" + arg + "'. Program terminated.");
+        else if (filename.empty())
+            filename = arg;
+        else
+            usageAbort("Too many arguments. Program terminated.");
+    }
+    if (filename.empty())
+        usageAbort("Missing argument. Program terminated.");
 
-    fstream file;
-    file.open(filename, ios::in);
-    if (!file)
+    auto source = Source::load(filename);
+    if (!source)
     {
         cout << "File '" << filename << "' does not exist." << endl;
         exit(1);
     }
-    stringstream buf;
-    buf << file.rdbuf();
-    string text = buf.str();
+    string_view text = source->text();
 
     try
     {
-        lexer::Lexer l(text);
-        auto tokens = l.lex();
-        // for (auto &token : tokens)
+        // tokens are lexed as they're parsed
+        lexer::Lexer l(text, 0, options.numThreads);
+        // for (auto &token : lexer::Lexer(text).lex())
         //     cout << token.repr() << endl;
-        parser::Parser p(tokens);
+        parser::Parser p(l);
         auto ast = p.parse();
         // printAst(ast);
-        interpreter::Interpreter i(move(ast), filename, text);
+        interpreter::Interpreter i(move(ast), filename, source, options);
         i.interpret();
     }
     catch (err::LexerParserException &e)
@@ -49,6 +93,6 @@ int main(int argc, char *argv[])
     }
     catch (err::InterpreterException &e)
     {
-        err::fatalErrorAbort(e.pos, e.filename, e.text, e.message);
+        err::fatalErrorAbort(e.pos, e.filename, e.source->text(), e.message);
     }
 }
\ No newline at end of file
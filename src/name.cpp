@@ -0,0 +1,65 @@
+#include <unordered_map>
+#include <mutex>
+#include "name.hpp"
+
+namespace snowlang
+{
+    namespace
+    {
+        // all names so far (by text, with the hash of their text)
+        struct Names
+        {
+            std::mutex mutex;
+            std::unordered_map<std::string, size_t> entries;
+        };
+
+        // names cached per thread (see Name(std::string_view))
+        const size_t RECENT_SIZE = 1024;
+
+        Names &names()
+        {
+            static Names names;
+            return names;
+        }
+
+        const std::pair<const std::string, size_t> *intern(
+            const std::string &text)
+        {
+            Names &all = names();
+            std::lock_guard<std::mutex> lock(all.mutex);
+            auto found = all.entries.find(text);
+            if (found == all.entries.end())
+                found = all.entries.emplace(
+                                       text, std::hash<std::string>()(text))
+                            .first;
+            return &*found;
+        }
+    }
+
+    Name::Name()
+    {
+        static const auto *empty = intern(std::string());
+        m_entry = empty;
+    }
+
+    Name::Name(std::string_view text)
+    {
+        // Names recently made on this thread, by hash. Most names are
+        // found here, without locking the table or copying the text.
+        static thread_local const std::pair<const std::string, size_t>
+            *recent[RECENT_SIZE];
+        size_t hash = std::hash<std::string_view>()(text);
+        auto &cached = recent[hash % RECENT_SIZE];
+        if (cached && cached->second == hash && cached->first == text)
+        {
+            m_entry = cached;
+            return;
+        }
+
+        // (the table is keyed by strings, so the text is looked up in a
+        // reused buffer rather than a new string)
+        static thread_local std::string key;
+        key.assign(text.data(), text.size());
+        m_entry = cached = intern(key);
+    }
+}
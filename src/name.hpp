@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <functional>
+
+namespace snowlang
+{
+    // Interned identifier.
+    // All names with the same text share one entry, so names are compared
+    // and hashed without looking at their text. Entries live until the
+    // program ends.
+    class Name
+    {
+    public:
+        // the empty name
+        Name();
+        // name with the given text (interned on first use)
+        explicit Name(std::string_view text);
+
+        inline const std::string &str() const
+        {
+            return m_entry->first;
+        }
+        // std::hash of the text, so tables keyed by names iterate in the
+        // same order as tables keyed by their text would
+        inline size_t hash() const
+        {
+            return m_entry->second;
+        }
+
+        inline bool operator==(const Name &other) const
+        {
+            return m_entry == other.m_entry;
+        }
+        inline bool operator!=(const Name &other) const
+        {
+            return m_entry != other.m_entry;
+        }
+
+    private:
+        // text and its hash
+        const std::pair<const std::string, size_t> *m_entry;
+    };
+}
+
+namespace std
+{
+    template <>
+    struct hash<snowlang::Name>
+    {
+        inline size_t operator()(const snowlang::Name &name) const
+        {
+            return name.hash();
+        }
+    };
+}
@@ -0,0 +1,658 @@
+#include <algorithm>
+#include "netlist.hpp"
+
+namespace snowlang
+{
+    Netlist::Netlist(const GateArena &gates, SimMode t_mode,
+                     size_t numThreads)
+        : mode(t_mode)
+    {
+        // gate ids are the ids of the arena, where gates of the same
+        // module (and of the same array) are consecutive
+        size_t numGates = gates.size();
+        size_t numWords =
+            (mode == SM_BATCH) ? numGates : (numGates + 63) / 64;
+        m_values.assign(numWords, 0);
+        m_nextValues.assign(numWords, 0);
+        m_holdFor.assign(numGates, 0);
+        types.reserve(numGates);
+        for (size_t id = 0; id < numGates; id++)
+            types.push_back(gates.type(id));
+
+        // sort the connection pool by gate (keeping the order of the
+        // dependencies of each gate)
+        fanInOffsets.assign(numGates + 1, 0);
+        for (auto &connection : gates.connections)
+            fanInOffsets[connection.to + 1]++;
+        for (size_t id = 0; id < numGates; id++)
+            fanInOffsets[id + 1] += fanInOffsets[id];
+        fanIn.resize(gates.connections.size());
+        std::vector<uint32_t> filled(
+            fanInOffsets.begin(), fanInOffsets.end() - 1);
+        for (auto &connection : gates.connections)
+            fanIn[filled[connection.to]++] = connection.from;
+
+        // keep values and holds set during elaboration
+        for (size_t id = 0; id < numGates; id++)
+        {
+            if (mode == SM_BATCH)
+                m_values[id] = gates.active(id) ? ~(uint64_t)0 : 0;
+            else
+                setBit(m_values, id, gates.active(id));
+        }
+        for (auto &hold : gates.holds)
+        {
+            if (hold.second <= 0)
+                continue;
+            if (mode == SM_BATCH)
+                m_laneHolds[hold.first].push_back(
+                    LaneHold{~(uint64_t)0, hold.second});
+            else
+            {
+                m_holdFor[hold.first] = hold.second;
+                m_held.push_back(hold.first);
+            }
+        }
+
+        if (mode == SM_EVENT)
+        {
+            buildFanOut();
+            // every gate is evaluated on the first tick
+            m_scheduled.assign(numGates, true);
+            m_activeGates.reserve(numGates);
+            for (size_t id = 0; id < numGates; id++)
+                m_activeGates.push_back(id);
+        }
+        else if (mode == SM_WORD)
+            buildRuns();
+        else if (mode == SM_SETTLE)
+            buildLevels();
+        else if (mode == SM_JIT)
+        {
+            // (the compiled code evaluates runs a word at a time)
+            buildRuns();
+            m_compiled = jit::CompiledCircuit::compile(*this);
+            m_heldBits.assign(numWords, 0);
+        }
+
+        // (the compiled circuit evaluates every gate itself)
+        if (mode == SM_EVENT || mode == SM_JIT || mode == SM_SETTLE)
+            numThreads = 1;
+        buildPartitions(numThreads);
+        if (m_partitions.size() > 2)
+            m_threadPool = std::make_unique<ThreadPool>(
+                m_partitions.size() - 1);
+    }
+
+    void Netlist::buildPartitions(size_t numThreads)
+    {
+        // partitions are ranges of consecutive gates, which keeps gates
+        // of the same module (and their connections) together.
+        // the cost of a gate is taken to be one plus its number of
+        // dependencies, and partitions are split to have similar costs.
+        uint32_t numGates = types.size();
+        size_t totalCost = numGates + fanIn.size();
+        m_partitions.push_back(0);
+        for (size_t i = 1; i < numThreads; i++)
+        {
+            size_t targetCost = totalCost * i / numThreads;
+            // first gate from which the cost of all previous gates is at
+            // least the target cost
+            uint32_t low = m_partitions.back(), high = numGates;
+            while (low < high)
+            {
+                uint32_t mid = low + (high - low) / 2;
+                if (mid + fanInOffsets[mid] < targetCost)
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            // partitions must not share words of gate values
+            uint32_t boundary = (mode == SM_BATCH) ? low : low / 64 * 64;
+            if (boundary > m_partitions.back() && boundary < numGates)
+                m_partitions.push_back(boundary);
+        }
+        m_partitions.push_back(numGates);
+
+        if (mode == SM_WORD)
+        {
+            // first run in each partition
+            size_t run = 0;
+            for (size_t i = 0; i + 1 < m_partitions.size(); i++)
+            {
+                while (run < runs.size() &&
+                       runs[run].first + runs[run].size <= m_partitions[i])
+                    run++;
+                m_partitionRuns.push_back(run);
+            }
+        }
+    }
+
+    Netlist::~Netlist() = default;
+
+    void Netlist::buildFanOut()
+    {
+        size_t numGates = types.size();
+        fanOutOffsets.assign(numGates + 1, 0);
+        for (auto dependency : fanIn)
+            fanOutOffsets[dependency + 1]++;
+        for (size_t id = 0; id < numGates; id++)
+            fanOutOffsets[id + 1] += fanOutOffsets[id];
+
+        fanOut.resize(fanIn.size());
+        std::vector<uint32_t> filled(
+            fanOutOffsets.begin(), fanOutOffsets.end() - 1);
+        for (size_t id = 0; id < numGates; id++)
+            for (uint32_t i = fanInOffsets[id]; i < fanInOffsets[id + 1]; i++)
+                fanOut[filled[fanIn[i]]++] = id;
+    }
+
+    void Netlist::buildRuns()
+    {
+        uint32_t numGates = types.size();
+        uint32_t first = 0;
+        while (first < numGates)
+        {
+            GateRun run{first, 1, (uint32_t)runStrides.size()};
+            uint32_t numDependencies =
+                fanInOffsets[first + 1] - fanInOffsets[first];
+            const uint32_t *dependencies = &fanIn[fanInOffsets[first]];
+
+            // the second gate decides the strides of the run
+            uint32_t second = first + 1;
+            bool extends =
+                second < numGates &&
+                types[second] == types[first] &&
+                fanInOffsets[second + 1] - fanInOffsets[second] ==
+                    numDependencies;
+            for (uint32_t j = 0; extends && j < numDependencies; j++)
+            {
+                uint32_t stride =
+                    fanIn[fanInOffsets[second] + j] - dependencies[j];
+                extends = (stride <= 1);
+                runStrides.push_back(stride);
+            }
+            if (!extends)
+            {
+                runStrides.resize(run.strides);
+                runs.push_back(run);
+                first++;
+                continue;
+            }
+
+            const uint8_t *strides = &runStrides[run.strides];
+            while (first + run.size < numGates)
+            {
+                uint32_t id = first + run.size;
+                if (types[id] != types[first] ||
+                    fanInOffsets[id + 1] - fanInOffsets[id] !=
+                        numDependencies)
+                    break;
+                bool matches = true;
+                for (uint32_t j = 0; matches && j < numDependencies; j++)
+                    matches = fanIn[fanInOffsets[id] + j] ==
+                              dependencies[j] + run.size * strides[j];
+                if (!matches)
+                    break;
+                run.size++;
+            }
+            runs.push_back(run);
+            first += run.size;
+        }
+    }
+
+    void Netlist::buildLevels()
+    {
+        // strongly connected components of the dependency graph
+        // (Tarjan's algorithm, iterative to handle long chains of gates).
+        // components are found dependencies first, so the order they are
+        // found in is an evaluation order.
+        uint32_t numGates = types.size();
+        const uint32_t unvisited = UINT32_MAX;
+        std::vector<uint32_t> index(numGates, unvisited);
+        std::vector<uint32_t> lowLink(numGates);
+        std::vector<bool> onStack(numGates, false);
+        std::vector<uint32_t> stack;
+        // component of each gate, and components in the order found
+        std::vector<uint32_t> component(numGates);
+        std::vector<uint32_t> componentOffsets{0};
+        std::vector<uint32_t> found;
+        found.reserve(numGates);
+        // depth first search frames: gate and next dependency to visit
+        std::vector<std::pair<uint32_t, uint32_t>> frames;
+        uint32_t nextIndex = 0;
+
+        for (uint32_t root = 0; root < numGates; root++)
+        {
+            if (index[root] != unvisited)
+                continue;
+            frames.emplace_back(root, fanInOffsets[root]);
+            index[root] = lowLink[root] = nextIndex++;
+            stack.push_back(root);
+            onStack[root] = true;
+            while (!frames.empty())
+            {
+                uint32_t id = frames.back().first;
+                uint32_t &next = frames.back().second;
+                if (next < fanInOffsets[id + 1])
+                {
+                    uint32_t dependency = fanIn[next++];
+                    if (index[dependency] == unvisited)
+                    {
+                        frames.emplace_back(
+                            dependency, fanInOffsets[dependency]);
+                        index[dependency] = lowLink[dependency] =
+                            nextIndex++;
+                        stack.push_back(dependency);
+                        onStack[dependency] = true;
+                    }
+                    else if (onStack[dependency])
+                        lowLink[id] = std::min(lowLink[id], index[dependency]);
+                    continue;
+                }
+
+                frames.pop_back();
+                if (!frames.empty())
+                {
+                    uint32_t parent = frames.back().first;
+                    lowLink[parent] = std::min(lowLink[parent], lowLink[id]);
+                }
+                if (lowLink[id] != index[id])
+                    continue;
+                // id is the root of a component
+                uint32_t member;
+                do
+                {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = false;
+                    component[member] = componentOffsets.size() - 1;
+                    found.push_back(member);
+                } while (member != id);
+                componentOffsets.push_back(found.size());
+            }
+        }
+
+        // level of each component
+        size_t numComponents = componentOffsets.size() - 1;
+        std::vector<uint32_t> levels(numComponents, 0);
+        uint32_t numLevels = 0;
+        for (size_t c = 0; c < numComponents; c++)
+        {
+            bool loop = componentOffsets[c + 1] - componentOffsets[c] > 1;
+            for (uint32_t i = componentOffsets[c];
+                 i < componentOffsets[c + 1]; i++)
+            {
+                uint32_t id = found[i];
+                for (uint32_t j = fanInOffsets[id];
+                     j < fanInOffsets[id + 1]; j++)
+                {
+                    uint32_t dependency = component[fanIn[j]];
+                    if (dependency == c)
+                        loop = true;
+                    else
+                        levels[c] = std::max(levels[c], levels[dependency] + 1);
+                }
+            }
+            numLoops += loop;
+            numLevels = std::max(numLevels, levels[c] + 1);
+        }
+
+        // sort gates by level, keeping the order they were found in
+        levelOffsets.assign(numLevels + 1, 0);
+        for (uint32_t id = 0; id < numGates; id++)
+            levelOffsets[levels[component[id]] + 1]++;
+        for (uint32_t level = 0; level < numLevels; level++)
+            levelOffsets[level + 1] += levelOffsets[level];
+        order.resize(numGates);
+        std::vector<uint32_t> filled(
+            levelOffsets.begin(), levelOffsets.end() - 1);
+        for (uint32_t id : found)
+            order[filled[levels[component[id]]]++] = id;
+    }
+
+    void Netlist::tick(size_t ticks)
+    {
+        if (m_compiled)
+        {
+            tickCompiled(ticks);
+            return;
+        }
+        for (size_t i = 0; i < ticks; i++)
+        {
+            if (mode == SM_EVENT)
+            {
+                tickEvent();
+                continue;
+            }
+            if (mode == SM_SETTLE)
+            {
+                tickSettle();
+                continue;
+            }
+
+            // evaluate partitions in parallel (next values of different
+            // partitions never share a word)
+            if (m_threadPool)
+                m_threadPool->run([this](size_t partition)
+                                  { generatePartition(partition); });
+            else
+                generatePartition(0);
+
+            if (mode == SM_BATCH)
+                updateLanes();
+            else
+                update();
+        }
+    }
+
+    void Netlist::generatePartition(size_t partition)
+    {
+        uint32_t firstGate = m_partitions[partition];
+        uint32_t lastGate = m_partitions[partition + 1];
+        if (mode == SM_BATCH)
+            generateNextLanes(firstGate, lastGate);
+        else if (mode == SM_WORD)
+            generateNextWords(
+                firstGate, lastGate, m_partitionRuns[partition]);
+        else
+            generateNextValue(firstGate, lastGate);
+    }
+
+    void Netlist::hold(uint32_t id, bool value, int holdFor, uint64_t lanes)
+    {
+        if (mode == SM_BATCH)
+        {
+            // the new hold replaces the held lanes' previous holds
+            auto &holds = m_laneHolds[id];
+            size_t stillHeld = 0;
+            for (auto &laneHold : holds)
+            {
+                laneHold.lanes &= ~lanes;
+                if (laneHold.lanes)
+                    holds[stillHeld++] = laneHold;
+            }
+            holds.resize(stillHeld);
+            holds.push_back(LaneHold{lanes, holdFor});
+            m_values[id] = (m_values[id] & ~lanes) | (value ? lanes : 0);
+            return;
+        }
+        // (gates not held have m_holdFor <= 0)
+        bool wasHeld = m_holdFor[id] > 0;
+        m_holdFor[id] = std::max(holdFor, 0);
+        if (!wasHeld && m_holdFor[id] > 0)
+            m_held.push_back(id);
+        if (mode == SM_EVENT && getBit(m_values, id) != value)
+            scheduleFanOut(id);
+        setBit(m_values, id, value);
+    }
+
+    void Netlist::generateNextValue(uint32_t firstGate, uint32_t lastGate)
+    {
+        for (size_t word = firstGate / 64; word * 64 < lastGate; word++)
+        {
+            uint64_t nextWord = 0;
+            size_t first = word * 64;
+            size_t last = std::min(first + 64, (size_t)lastGate);
+            for (size_t id = first; id < last; id++)
+            {
+                if (evaluate(id))
+                    nextWord |= (uint64_t)1 << (id - first);
+            }
+            m_nextValues[word] = nextWord;
+        }
+    }
+
+    void Netlist::generateNextWords(
+        uint32_t firstGate, uint32_t lastGate, size_t firstRun)
+    {
+        // runs shorter than this are cheaper to evaluate gate by gate
+        const uint32_t minWordRun = 8;
+
+        std::fill(m_nextValues.begin() + firstGate / 64,
+                  m_nextValues.begin() + (lastGate + 63) / 64, 0);
+        for (size_t i = firstRun; i < runs.size(); i++)
+        {
+            auto &run = runs[i];
+            if (run.first >= lastGate)
+                break;
+            // part of the run in the given range
+            uint32_t begin = std::max(run.first, firstGate);
+            uint32_t end = std::min(run.first + run.size, lastGate);
+
+            if (run.size < minWordRun)
+            {
+                for (uint32_t id = begin; id < end; id++)
+                    if (evaluate(id))
+                        m_nextValues[id >> 6] |= (uint64_t)1 << (id & 63);
+                continue;
+            }
+
+            uint32_t numDependencies =
+                fanInOffsets[run.first + 1] - fanInOffsets[run.first];
+            if (numDependencies == 0) // inactive
+                continue;
+            const uint32_t *dependencies = &fanIn[fanInOffsets[run.first]];
+            const uint8_t *strides = &runStrides[run.strides];
+            GateType type = types[run.first];
+            bool isAnd = (type == GT_AND || type == GT_NAND);
+            bool isOr = (type == GT_OR || type == GT_NOR);
+            bool inverted =
+                (type == GT_NOR || type == GT_NAND || type == GT_XNOR);
+
+            // one word of next values at a time
+            uint32_t done = begin - run.first;
+            while (run.first + done < end)
+            {
+                uint32_t id = run.first + done;
+                uint32_t offset = id & 63;
+                uint32_t gates = std::min(64 - offset, end - id);
+
+                uint64_t result = isAnd ? ~(uint64_t)0 : 0;
+                for (uint32_t j = 0; j < numDependencies; j++)
+                {
+                    uint64_t inputs;
+                    if (strides[j])
+                        inputs = getWord(m_values, dependencies[j] + done);
+                    else // the same dependency for all gates
+                        inputs = getBit(m_values, dependencies[j])
+                                     ? ~(uint64_t)0
+                                     : 0;
+                    if (isAnd)
+                        result &= inputs;
+                    else if (isOr)
+                        result |= inputs;
+                    else
+                        result ^= inputs;
+                }
+                if (inverted)
+                    result = ~result;
+                if (gates < 64)
+                    result &= ((uint64_t)1 << gates) - 1;
+                m_nextValues[id >> 6] |= result << offset;
+                done += gates;
+            }
+        }
+    }
+
+    void Netlist::generateNextLanes(uint32_t firstGate, uint32_t lastGate)
+    {
+        for (size_t id = firstGate; id < lastGate; id++)
+        {
+            uint32_t begin = fanInOffsets[id];
+            uint32_t end = fanInOffsets[id + 1];
+            if (begin == end) // inactive
+            {
+                m_nextValues[id] = 0;
+                continue;
+            }
+            GateType type = types[id];
+            uint64_t result = 0;
+            if (type == GT_AND || type == GT_NAND)
+            {
+                result = ~(uint64_t)0;
+                for (uint32_t i = begin; i < end; i++)
+                    result &= m_values[fanIn[i]];
+            }
+            else if (type == GT_OR || type == GT_NOR)
+            {
+                for (uint32_t i = begin; i < end; i++)
+                    result |= m_values[fanIn[i]];
+            }
+            else
+            {
+                for (uint32_t i = begin; i < end; i++)
+                    result ^= m_values[fanIn[i]];
+            }
+            if (type == GT_NOR || type == GT_NAND || type == GT_XNOR)
+                result = ~result;
+            m_nextValues[id] = result;
+        }
+    }
+
+    void Netlist::update()
+    {
+        // held gates keep their value until their hold runs out
+        size_t stillHeld = 0;
+        for (auto id : m_held)
+        {
+            m_holdFor[id]--;
+            if (m_holdFor[id] > 0)
+            {
+                setBit(m_nextValues, id, getBit(m_values, id));
+                m_held[stillHeld++] = id;
+            }
+        }
+        m_held.resize(stillHeld);
+        m_values.swap(m_nextValues);
+    }
+
+    void Netlist::tickEvent()
+    {
+        // held gates are evaluated on every tick so that they take their
+        // generated value as soon as their hold runs out
+        for (auto id : m_held)
+            schedule(id);
+
+        m_evaluating.swap(m_activeGates);
+        m_activeGates.clear();
+        for (auto id : m_evaluating)
+        {
+            setBit(m_nextValues, id, evaluate(id));
+            m_scheduled[id] = false;
+        }
+
+        // commit values and schedule the fan-out of every changed gate
+        for (auto id : m_evaluating)
+        {
+            if (m_holdFor[id] > 0)
+            {
+                m_holdFor[id]--;
+                if (m_holdFor[id] > 0)
+                    continue;
+            }
+            bool next = getBit(m_nextValues, id);
+            if (next != getBit(m_values, id))
+            {
+                setBit(m_values, id, next);
+                scheduleFanOut(id);
+            }
+        }
+
+        size_t stillHeld = 0;
+        for (auto id : m_held)
+            if (m_holdFor[id] > 0)
+                m_held[stillHeld++] = id;
+        m_held.resize(stillHeld);
+    }
+
+    void Netlist::updateLanes()
+    {
+        // held lanes keep their value until their hold runs out
+        for (auto it = m_laneHolds.begin(); it != m_laneHolds.end();)
+        {
+            uint32_t id = it->first;
+            auto &holds = it->second;
+            uint64_t keep = 0;
+            size_t stillHeld = 0;
+            for (auto &laneHold : holds)
+            {
+                laneHold.holdFor--;
+                if (laneHold.holdFor > 0)
+                {
+                    keep |= laneHold.lanes;
+                    holds[stillHeld++] = laneHold;
+                }
+            }
+            holds.resize(stillHeld);
+            m_nextValues[id] =
+                (m_nextValues[id] & ~keep) | (m_values[id] & keep);
+            if (holds.empty())
+                it = m_laneHolds.erase(it);
+            else
+                it++;
+        }
+        m_values.swap(m_nextValues);
+    }
+
+    void Netlist::tickCompiled(size_t ticks)
+    {
+        while (ticks > 0)
+        {
+            // a gate held for n ticks keeps its value on the next n - 1
+            // ticks, so ticks are run in stretches over which the same
+            // gates are kept
+            size_t stretch = ticks;
+            bool kept = false;
+            for (auto id : m_held)
+            {
+                if (m_holdFor[id] <= 1)
+                    continue;
+                stretch = std::min(stretch, (size_t)m_holdFor[id] - 1);
+                setBit(m_heldBits, id, true);
+                kept = true;
+            }
+            m_compiled->step(m_values.data(), m_nextValues.data(),
+                             kept ? m_heldBits.data() : nullptr, stretch);
+            if (stretch % 2 == 1)
+                m_values.swap(m_nextValues);
+            ticks -= stretch;
+
+            size_t stillHeld = 0;
+            for (auto id : m_held)
+            {
+                setBit(m_heldBits, id, false);
+                m_holdFor[id] = (size_t)m_holdFor[id] > stretch
+                                    ? m_holdFor[id] - (int)stretch
+                                    : 0;
+                if (m_holdFor[id] > 0)
+                    m_held[stillHeld++] = id;
+            }
+            m_held.resize(stillHeld);
+        }
+    }
+
+    void Netlist::tickSettle()
+    {
+        // held gates keep their values while still held after this tick
+        for (auto id : m_held)
+            m_holdFor[id]--;
+
+        // gates are updated in place, so a gate sees the values its
+        // dependencies take on this tick (and the values of the previous
+        // tick for dependencies later in its feedback loop)
+        for (auto id : order)
+        {
+            if (m_holdFor[id] <= 0)
+                setBit(m_values, id, evaluate(id));
+        }
+
+        size_t stillHeld = 0;
+        for (auto id : m_held)
+        {
+            if (m_holdFor[id] > 0)
+                m_held[stillHeld++] = id;
+        }
+        m_held.resize(stillHeld);
+    }
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include "logic.hpp"
+#include "threadPool.hpp"
+#include "jit.hpp"
+
+namespace snowlang
+{
+    enum SimMode
+    {
+        SM_SWEEP, // every gate is evaluated on every tick
+        SM_EVENT, // only gates whose inputs changed on the last tick are
+                  // evaluated
+        SM_WORD,  // runs of similar gates (e.g. gate arrays) are evaluated
+                  // 64 gates at a time using bitwise operations
+        SM_BATCH, // 64 independent simulations (lanes) at once, with one
+                  // bit per lane for every gate
+        SM_JIT,   // the netlist is compiled to native code
+        SM_SETTLE // combinational logic settles within a tick: gates are
+                  // evaluated in dependency order, and only feedback loops
+                  // take a tick per gate
+    };
+
+    // a run of consecutive gates with the same type and number of
+    // dependencies, where the j-th dependency of each gate is either the
+    // same gate for all gates in the run (stride 0) or the gate after
+    // the j-th dependency of the previous gate (stride 1).
+    struct GateRun
+    {
+        uint32_t first;
+        uint32_t size;
+        // offset of the run's dependency strides in Netlist::runStrides
+        uint32_t strides;
+    };
+
+    // Flat representation of an elaborated circuit.
+    // Gates are identified by their id in the gate arena.
+    class Netlist
+    {
+    public:
+        const SimMode mode;
+
+        // gate type of each gate
+        std::vector<GateType> types;
+
+        // fan-in of gate i is fanIn[fanInOffsets[i]] up to (not including)
+        // fanIn[fanInOffsets[i + 1]] (compressed sparse rows)
+        std::vector<uint32_t> fanInOffsets;
+        std::vector<uint32_t> fanIn;
+
+        // fan-out of gate i is fanOut[fanOutOffsets[i]] up to (not including)
+        // fanOut[fanOutOffsets[i + 1]] (only built in event mode)
+        std::vector<uint32_t> fanOutOffsets;
+        std::vector<uint32_t> fanOut;
+
+        // runs covering all gates in order (only built in word and jit
+        // mode)
+        std::vector<GateRun> runs;
+        std::vector<uint8_t> runStrides;
+
+        // gates in evaluation order, grouped by level, where a gate's
+        // level is one above the highest level of its dependencies
+        // outside of its own feedback loop (only built in settle mode).
+        // level i is order[levelOffsets[i]] up to (not including)
+        // order[levelOffsets[i + 1]], and gates of the same feedback loop
+        // (strongly connected component) are consecutive.
+        std::vector<uint32_t> order;
+        std::vector<uint32_t> levelOffsets;
+        // number of feedback loops (only built in settle mode)
+        size_t numLoops = 0;
+
+        // number of lanes in batch mode
+        static const size_t batchLanes = 64;
+
+        // flattens the gates of a module tree.
+        // initial gate values and holds are taken from the arena.
+        // gates are evaluated on numThreads threads
+        // (except in event and settle mode).
+        explicit Netlist(const GateArena &gates, SimMode t_mode = SM_SWEEP,
+                         size_t numThreads = 1);
+        ~Netlist();
+
+        // jit mode: whether the netlist was compiled
+        // (if compilation fails, ticks are run as in sweep mode)
+        inline bool compiled() const
+        {
+            return m_compiled != nullptr;
+        }
+
+        void tick(size_t ticks = 1);
+
+        inline size_t numLanes() const
+        {
+            return mode == SM_BATCH ? batchLanes : 1;
+        }
+        inline bool value(uint32_t id, size_t lane = 0) const
+        {
+            if (mode == SM_BATCH)
+                return (m_values[id] >> lane) & 1;
+            return getBit(m_values, id);
+        }
+        // lanes is a mask of the lanes to hold (used in batch mode only)
+        void hold(uint32_t id, bool value, int holdFor,
+                  uint64_t lanes = ~(uint64_t)0);
+
+        inline size_t numGates() const
+        {
+            return types.size();
+        }
+        inline size_t numConnections() const
+        {
+            return fanIn.size();
+        }
+
+    private:
+        // gate values, one bit per gate
+        // (one word per gate, with a bit for each lane, in batch mode)
+        std::vector<uint64_t> m_values;
+        std::vector<uint64_t> m_nextValues;
+
+        // batch mode: lanes of a gate held for the same number of ticks
+        struct LaneHold
+        {
+            uint64_t lanes;
+            int holdFor;
+        };
+        // batch mode: holds of every held gate
+        std::unordered_map<uint32_t, std::vector<LaneHold>> m_laneHolds;
+
+        // ticks left for each gate to be held (0 if not held)
+        std::vector<int> m_holdFor;
+        // ids of all gates with m_holdFor > 0
+        std::vector<uint32_t> m_held;
+
+        // event mode: gates to evaluate on the next tick
+        // (m_scheduled[id] is set for every gate in m_activeGates)
+        // and gates being evaluated on the current tick.
+        std::vector<uint32_t> m_activeGates;
+        std::vector<uint32_t> m_evaluating;
+        std::vector<bool> m_scheduled;
+
+        // boundaries of the ranges of gates evaluated by each thread
+        // (partition i is gates m_partitions[i] up to m_partitions[i + 1])
+        std::vector<uint32_t> m_partitions;
+        // word mode: first run of each partition
+        std::vector<size_t> m_partitionRuns;
+        std::unique_ptr<ThreadPool> m_threadPool;
+
+        std::unique_ptr<jit::CompiledCircuit> m_compiled;
+        // jit mode: bits of the gates kept by their holds
+        std::vector<uint64_t> m_heldBits;
+
+        void buildFanOut();
+        void buildRuns();
+        void buildLevels();
+        void buildPartitions(size_t numThreads);
+        void generatePartition(size_t partition);
+        void generateNextValue(uint32_t firstGate, uint32_t lastGate);
+        void generateNextWords(
+            uint32_t firstGate, uint32_t lastGate, size_t firstRun);
+        void generateNextLanes(uint32_t firstGate, uint32_t lastGate);
+        void update();
+        void updateLanes();
+        void tickEvent();
+        void tickSettle();
+        void tickCompiled(size_t ticks);
+
+        inline bool evaluate(uint32_t id)
+        {
+            uint32_t begin = fanInOffsets[id];
+            uint32_t end = fanInOffsets[id + 1];
+            size_t activeGates = 0;
+            for (uint32_t i = begin; i < end; i++)
+                activeGates += getBit(m_values, fanIn[i]);
+            return gateOutput(types[id], activeGates, end - begin);
+        }
+        inline void schedule(uint32_t id)
+        {
+            if (!m_scheduled[id])
+            {
+                m_scheduled[id] = true;
+                m_activeGates.push_back(id);
+            }
+        }
+        inline void scheduleFanOut(uint32_t id)
+        {
+            for (uint32_t i = fanOutOffsets[id];
+                 i < fanOutOffsets[id + 1]; i++)
+                schedule(fanOut[i]);
+        }
+
+        static inline bool getBit(
+            const std::vector<uint64_t> &bits, uint32_t id)
+        {
+            return (bits[id >> 6] >> (id & 63)) & 1;
+        }
+        // 64 bits starting at the given bit (bits past the end are 0)
+        static inline uint64_t getWord(
+            const std::vector<uint64_t> &bits, size_t start)
+        {
+            size_t word = start >> 6;
+            size_t shift = start & 63;
+            uint64_t low = bits[word] >> shift;
+            if (shift == 0 || word + 1 >= bits.size())
+                return low;
+            return low | (bits[word + 1] << (64 - shift));
+        }
+        static inline void setBit(
+            std::vector<uint64_t> &bits, uint32_t id, bool value)
+        {
+            if (value)
+                bits[id >> 6] |= (uint64_t)1 << (id & 63);
+            else
+                bits[id >> 6] &= ~((uint64_t)1 << (id & 63));
+        }
+    };
+}
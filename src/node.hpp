@@ -2,14 +2,25 @@
 
 #include <iostream>
 #include <variant>
+#include <vector>
 #include "token.hpp"
 
 namespace snowlang
 {
+    // Nodes live in an Ast and refer to their children (and tokens) by
+    // index. Index 0 is never used, so it means no node (or no token).
+    using NodeId = uint32_t;
+    using TokenId = uint32_t;
+
+    // children of a node that has a list of them
+    // (`size` consecutive entries of Ast::lists starting at `first`)
+    struct NodeList
+    {
+        uint32_t first{0};
+        uint32_t size{0};
+    };
 
-    class Node;
-
-    enum NodeType
+    enum NodeType : uint8_t
     {
         NT_BINOP,
         NT_UNOP,
@@ -38,218 +49,126 @@ namespace snowlang
 
     struct LeafValue
     {
-        Token token;
-
-        LeafValue(Token t_token)
-            : token(t_token) {}
+        TokenId token;
     };
+
     struct BinOpValue
     {
-        std::unique_ptr<Node> left{nullptr};
-        std::unique_ptr<Node> right{nullptr};
-        Token operationToken;
-
-        BinOpValue(
-            std::unique_ptr<Node> t_left,
-            std::unique_ptr<Node> t_right,
-            Token t_operationToken)
-            : left(std::move(t_left)),
-              right(std::move(t_right)),
-              operationToken(t_operationToken) {}
+        NodeId left;
+        NodeId right;
+        TokenType operation;
     };
 
     struct UnOpValue
     {
-        std::unique_ptr<Node> node{nullptr};
-        Token operationToken;
-
-        UnOpValue(std::unique_ptr<Node> t_node, Token t_operationToken)
-            : node(std::move(t_node)), operationToken(t_operationToken) {}
+        NodeId node;
+        TokenType operation;
     };
 
     struct ItemValue
     {
-        Token identifier;
-
-        // If value is nullptr, identifier is not indexed
-        std::unique_ptr<Node> index{nullptr};
-        std::unique_ptr<Node> next{nullptr};
-
-        ItemValue(Token t_identifier,
-                  std::unique_ptr<Node> t_index,
-                  std::unique_ptr<Node> t_next)
-            : identifier(t_identifier),
-              index(std::move(t_index)),
-              next(std::move(t_next)) {}
+        TokenId identifier;
+        // If 0, identifier is not indexed
+        NodeId index{0};
+        NodeId next{0};
     };
 
     struct DefineValue
     {
-        Token typeName;
-        std::unique_ptr<Node> arraySize;
-        std::vector<std::unique_ptr<Node>> args;
-        Token identifier;
-
-        DefineValue(
-            Token t_typeName,
-            std::unique_ptr<Node> t_arraySize,
-            std::vector<std::unique_ptr<Node>> t_args,
-            Token t_identifier)
-            : typeName(t_typeName), arraySize(std::move(t_arraySize)),
-              args(std::move(t_args)), identifier(t_identifier) {}
+        TokenId typeName;
+        NodeId arraySize{0};
+        NodeList args;
+        TokenId identifier;
     };
 
     struct ConValue
     {
-        std::unique_ptr<Node> left{nullptr};
-        std::unique_ptr<Node> right{nullptr};
-
-        ConValue(std::unique_ptr<Node> t_left,
-                 std::unique_ptr<Node> t_right)
-            : left(std::move(t_left)), right(std::move(t_right)) {}
+        NodeId left;
+        NodeId right;
     };
 
     struct ForValue
     {
-        Token var;
-        std::unique_ptr<Node> from;
-        std::unique_ptr<Node> to;
-        std::unique_ptr<Node> block;
-
-        ForValue(
-            Token t_var,
-            std::unique_ptr<Node> t_from,
-            std::unique_ptr<Node> t_to,
-            std::unique_ptr<Node> t_block)
-            : var(t_var),
-              from(std::move(t_from)),
-              to(std::move(t_to)),
-              block(std::move(t_block)) {}
+        TokenId var;
+        NodeId from;
+        NodeId to;
+        NodeId block;
     };
 
     struct WhileValue
     {
-        std::unique_ptr<Node> cond;
-        std::unique_ptr<Node> block;
-
-        WhileValue(
-            std::unique_ptr<Node> t_cond,
-            std::unique_ptr<Node> t_block)
-            : cond(std::move(t_cond)),
-              block(std::move(t_block)) {}
+        NodeId cond;
+        NodeId block;
     };
 
     struct BreakValue
     {
-        BreakValue() = default;
     };
 
     struct ContinueValue
     {
-        ContinueValue() = default;
     };
 
     struct ReturnValue
     {
-        std::unique_ptr<Node> expression;
-
-        ReturnValue(std::unique_ptr<Node> t_expression)
-            : expression(std::move(t_expression)) {}
+        NodeId expression;
     };
 
     struct IfValue
     {
-        std::vector<std::unique_ptr<Node>> conds;
-        std::vector<std::unique_ptr<Node>> ifBlocks;
-
-        IfValue(std::vector<std::unique_ptr<Node>> t_conds,
-                std::vector<std::unique_ptr<Node>> t_ifBlocks)
-            : conds(std::move(t_conds)),
-              ifBlocks(std::move(t_ifBlocks)) {}
+        NodeList conds;
+        NodeList ifBlocks;
     };
 
     struct BlockValue
     {
-        std::vector<std::unique_ptr<Node>> fields;
-
-        BlockValue(std::vector<std::unique_ptr<Node>> t_instructions)
-            : fields(std::move(t_instructions)) {}
+        NodeList fields;
     };
 
     struct DeclValue
     {
-        Token identifier;
-        std::vector<std::unique_ptr<Node>> args;
-        std::unique_ptr<Node> body;
-
-        DeclValue(
-            Token &t_identifier,
-            std::vector<std::unique_ptr<Node>> t_args,
-            std::unique_ptr<Node> t_body)
-            : identifier(t_identifier),
-              args(std::move(t_args)),
-              body(std::move(t_body)) {}
+        TokenId identifier;
+        NodeList args;
+        NodeId body;
     };
 
     struct FuncCallValue
     {
-        Token identifier;
-        std::vector<std::unique_ptr<Node>> args;
-
-        FuncCallValue(
-            Token &t_identifier,
-            std::vector<std::unique_ptr<Node>> t_args)
-            : identifier(t_identifier),
-              args(std::move(t_args)) {}
+        TokenId identifier;
+        NodeList args;
     };
 
     struct VarAssignValue
     {
         // expected lhs is leaf node with iden token
-        // if lhs is nullptr then rhs will simply be
+        // if lhs is 0 then rhs will simply be
         // evaluated and not assigned to any variable
-        std::unique_ptr<Node> lhs;
-        std::unique_ptr<Node> rhs;
-
-        VarAssignValue(
-            std::unique_ptr<Node> t_lhs, std::unique_ptr<Node> t_rhs)
-            : lhs(std::move(t_lhs)), rhs(std::move(t_rhs)) {}
+        NodeId lhs;
+        NodeId rhs;
     };
 
     struct PrintValue
     {
-        Token strlit = Token();
-        std::vector<std::unique_ptr<Node>> expressions;
-        std::unique_ptr<Node> item{nullptr};
-
-        PrintValue(Token t_strlit,
-                   std::vector<std::unique_ptr<Node>> t_expressions)
-            : strlit(t_strlit), expressions(std::move(t_expressions)) {}
-
-        PrintValue(std::unique_ptr<Node> t_item)
-            : item(std::move(t_item)) {}
+        // If 0, an item is printed
+        TokenId strlit{0};
+        NodeList expressions;
+        NodeId item{0};
+        // If 0, lane 0 is printed
+        NodeId lane{0};
     };
 
     struct TickValue
     {
-        std::unique_ptr<Node> expression;
-
-        TickValue(std::unique_ptr<Node> t_expression)
-            : expression(std::move(t_expression)) {}
+        NodeId expression;
     };
 
     struct HoldValue
     {
-        std::unique_ptr<Node> item;
-        std::unique_ptr<Node> holdFor;
-        Token holdAs;
-
-        HoldValue(std::unique_ptr<Node> t_item,
-                  std::unique_ptr<Node> t_holdFor,
-                  Token t_holdAs)
-            : item(std::move(t_item)),
-              holdFor(std::move(t_holdFor)),
-              holdAs(t_holdAs) {}
+        NodeId item;
+        NodeId holdFor;
+        TokenId holdAs;
+        // If 0, all lanes are held
+        NodeId lane{0};
     };
 
     ///////////////
@@ -274,7 +193,70 @@ namespace snowlang
 
         Node(enum NodeType t_type, NodeValueType t_value,
              const Pos &t_pos)
-            : type(t_type), value(std::move(t_value)),
-              pos(t_pos) {}
+            : type(t_type), value(t_value), pos(t_pos) {}
+    };
+
+    // consecutive children of a node (see NodeList)
+    struct NodeRange
+    {
+        const NodeId *first;
+        const NodeId *last;
+
+        inline const NodeId *begin() const { return first; }
+        inline const NodeId *end() const { return last; }
+        inline size_t size() const { return last - first; }
+        inline bool empty() const { return first == last; }
+        inline NodeId operator[](size_t i) const { return first[i]; }
+    };
+
+    // Arena holding a parsed script or instruction.
+    // Nodes, the tokens they keep and their lists of children are stored
+    // in three vectors, so the tree takes a few allocations in all and is
+    // freed in one go when the Ast is destroyed.
+    struct Ast
+    {
+        std::vector<Node> nodes;
+        std::vector<Token> tokens;
+        std::vector<NodeId> lists;
+        NodeId root{0};
+
+        // reserves index 0 of nodes and tokens
+        Ast()
+        {
+            nodes.emplace_back(NT_LEAF, LeafValue{0}, Pos());
+            tokens.emplace_back();
+        }
+
+        inline NodeId add(
+            enum NodeType type, const NodeValueType &value, const Pos &pos)
+        {
+            nodes.emplace_back(type, value, pos);
+            return nodes.size() - 1;
+        }
+        inline TokenId add(const Token &token)
+        {
+            tokens.push_back(token);
+            return tokens.size() - 1;
+        }
+        // appends `ids` from index `from` on as a list
+        inline NodeList list(const std::vector<NodeId> &ids, size_t from)
+        {
+            NodeList list{(uint32_t)lists.size(),
+                          (uint32_t)(ids.size() - from)};
+            lists.insert(lists.end(), ids.begin() + from, ids.end());
+            return list;
+        }
+
+        // nullptr if id is 0
+        inline const Node *node(NodeId id) const
+        {
+            return id ? &nodes[id] : nullptr;
+        }
+        inline const Token &token(TokenId id) const { return tokens[id]; }
+        inline NodeRange list(NodeList list) const
+        {
+            const NodeId *first = lists.data() + list.first;
+            return NodeRange{first, first + list.size};
+        }
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "netlist.hpp"
+
+namespace snowlang
+{
+    // most threads that can be asked for with --threads
+    const size_t MAX_THREADS = 256;
+
+    // options given on the command line
+    struct Options
+    {
+        SimMode simMode = SM_SWEEP;
+        // threads used to evaluate gates on every tick
+        size_t numThreads = 1;
+        // whether results of function calls are reused
+        bool cacheResults = true;
+    };
+}
@@ -1,11 +1,47 @@
 #include <iostream>
-#include <unordered_set>
+#include <array>
 #include "parser.hpp"
 
 using namespace std;
 
 namespace snowlang::parser
 {
+    namespace
+    {
+        // precedences of binary operators (higher binds tighter)
+        enum Precedence
+        {
+            PREC_NONE, // not a binary operator
+            PREC_AND,
+            PREC_OR,
+            PREC_EQUALITY,
+            PREC_INEQUALITY,
+            PREC_SUM,
+            PREC_PRODUCT,
+            PREC_POW
+        };
+
+        constexpr std::array<int, TT_STRLIT + 1> precedences()
+        {
+            std::array<int, TT_STRLIT + 1> result{};
+            result[TT_AND] = PREC_AND;
+            result[TT_OR] = PREC_OR;
+            result[TT_EQ] = result[TT_NEQ] = PREC_EQUALITY;
+            result[TT_GT] = result[TT_GE] = PREC_INEQUALITY;
+            result[TT_LE] = result[TT_LT] = PREC_INEQUALITY;
+            result[TT_PLUS] = result[TT_MINUS] = PREC_SUM;
+            result[TT_MULT] = result[TT_DIV] = PREC_PRODUCT;
+            result[TT_REM] = PREC_PRODUCT;
+            result[TT_POW] = PREC_POW;
+            return result;
+        }
+
+        // precedence of each token type
+        constexpr std::array<int, TT_STRLIT + 1> PRECEDENCES = precedences();
+
+        constexpr TokenSet UNARY_OPERATORS = {TT_PLUS, TT_MINUS, TT_NOT};
+    }
+
     inline bool Parser::accept(
         TokenType type,
         const std::string &errorMessage)
@@ -22,10 +58,10 @@ namespace snowlang::parser
     }
 
     bool Parser::accept(
-        std::unordered_set<TokenType> types,
+        TokenSet types,
         const std::string &errorMessage)
     {
-        if (types.count(current().type) > 0)
+        if (types.contains(current().type))
         {
             m_acceptedToken = current();
             advance();
@@ -36,9 +72,9 @@ namespace snowlang::parser
         throw err::LexerParserException(current().pos, errorMessage);
     }
 
-    unique_ptr<Node> Parser::script()
+    NodeId Parser::script()
     {
-        vector<unique_ptr<Node>> fields;
+        size_t fields = m_children.size();
         while (accept({TT_MOD, TT_LET, TT_IMPORT}))
         {
             int posStart = accepted().pos.start;
@@ -46,99 +82,97 @@ namespace snowlang::parser
             {
                 // Parse identifier
                 accept(TT_IDEN, err::EXPECTED_IDEN);
-                auto identifier = accepted();
+                auto identifier = keepAccepted();
 
                 // Parse arguments
-                vector<unique_ptr<Node>> args;
+                size_t args = m_children.size();
                 if (accept(TT_LPAREN))
                 {
                     if (typeIs(TT_IDEN))
                     {
                         do
                         {
-                            args.push_back(assign());
+                            m_children.push_back(assign());
                         } while (accept(TT_COMMA));
                     }
                     accept(TT_RPAREN, err::EXPECTED_RPAREN);
                 }
+                NodeList argList = endList(args);
                 accept(TT_LBRACE, err::EXPECTED_LBRACE);
                 auto body = block();
                 accept(TT_RBRACE, err::EXPECTED_RBRACE);
                 int posEnd = accepted().pos.end;
 
-                fields.push_back(make_unique<Node>(
+                m_children.push_back(m_ast.add(
                     NT_MOD,
-                    DeclValue(identifier, move(args), move(body)),
+                    DeclValue{identifier, argList, body},
                     Pos(posStart, posEnd, fileIndex)));
             }
             else if (accepted().type == TT_LET)
             {
                 accept(TT_IDEN, err::EXPECTED_IDEN);
-                auto identifier = accepted();
+                auto identifier = keepAccepted();
                 accept(TT_LPAREN, err::EXPECTED_LPAREN);
-                vector<unique_ptr<Node>> args;
+                size_t args = m_children.size();
                 if (typeIs(TT_IDEN))
                 {
                     do
                     {
-                        args.push_back(assign());
+                        m_children.push_back(assign());
                     } while (accept(TT_COMMA));
                 }
                 accept(TT_RPAREN, err::EXPECTED_RPAREN);
+                NodeList argList = endList(args);
                 accept(TT_LBRACE, err::EXPECTED_LBRACE);
                 auto body = block();
                 accept(TT_RBRACE, err::EXPECTED_RBRACE);
                 int posEnd = accepted().pos.end;
 
-                fields.push_back(make_unique<Node>(
+                m_children.push_back(m_ast.add(
                     NT_FUNCDECL,
-                    DeclValue(identifier, move(args), move(body)),
+                    DeclValue{identifier, argList, body},
                     Pos(posStart, posEnd, fileIndex)));
             }
             else if (accepted().type == TT_IMPORT)
             {
                 accept(TT_STRLIT, err::EXPECTED_STRLIT);
-                auto strlit = accepted();
+                auto strlit = keepAccepted();
                 accept(TT_SEMICOLON, err::EXPECTED_SEMICOLON);
                 int posEnd = accepted().pos.end;
-                fields.push_back(make_unique<Node>(
-                    NT_IMPORT, LeafValue(strlit),
+                m_children.push_back(m_ast.add(
+                    NT_IMPORT, LeafValue{strlit},
                     Pos(posStart, posEnd, fileIndex)));
             }
         }
         int posStart = 0, posEnd = 0;
-        if (!fields.empty()) // avoid undefined behavior
+        if (m_children.size() > fields) // avoid undefined behavior
         {
-            posStart = fields.front()->pos.start;
-            posEnd = fields.back()->pos.end;
+            posStart = posOf(m_children[fields]).start;
+            posEnd = posOf(m_children.back()).end;
         }
-        return make_unique<Node>(
-            NT_BLOCK, BlockValue(move(fields)),
+        return m_ast.add(
+            NT_BLOCK, BlockValue{endList(fields)},
             Pos(posStart, posEnd, fileIndex));
     }
 
-    unique_ptr<Node> Parser::block()
+    NodeId Parser::block()
     {
-        vector<unique_ptr<Node>> instructions;
-        while (typeIs(
-                   {TT_LET, TT_CON, TT_FOR, TT_WHILE,
-                    TT_BREAK, TT_CONTINUE, TT_IF, TT_RETURN,
-                    TT_PRINT, TT_TICK, TT_HOLD}) ||
-               typeIs(FIRST_OF_EXPR))
-            instructions.push_back(instruction());
+        size_t instructions = m_children.size();
+        while (typeIs(FIRST_OF_INSTRUCTION) || typeIs(FIRST_OF_EXPR))
+            m_children.push_back(instruction());
         int posStart = 0, posEnd = 0;
-        if (!instructions.empty()) // avoid undefined behavior
+        if (m_children.size() > instructions) // avoid undefined behavior
         {
-            posStart = instructions.front()->pos.start;
-            posEnd = instructions.back()->pos.end;
+            posStart = posOf(m_children[instructions]).start;
+            posEnd = posOf(m_children.back()).end;
         }
-        return make_unique<Node>(
+        return m_ast.add(
             NT_BLOCK,
-            BlockValue(move(instructions)),
+            BlockValue{endList(instructions)},
             Pos(posStart, posEnd, fileIndex));
     }
 
-    unique_ptr<Node> Parser::instruction()
+    NodeId Parser::instruction()
     {
         Pos pos(fileIndex);
         if (typeIs(TT_LET))
@@ -154,15 +188,14 @@ namespace snowlang::parser
             pos.start = accepted().pos.start;
             accept(TT_SEMICOLON, err::EXPECTED_SEMICOLON);
             pos.end = accepted().pos.end;
-            return make_unique<Node>(NT_BREAK, BreakValue(), pos);
+            return m_ast.add(NT_BREAK, BreakValue(), pos);
         }
         else if (accept(TT_CONTINUE))
         {
             pos.start = accepted().pos.start;
             accept(TT_SEMICOLON, err::EXPECTED_SEMICOLON);
             pos.end = accepted().pos.end;
-            return make_unique<Node>(
-                NT_CONTINUE, ContinueValue(), pos);
+            return m_ast.add(NT_CONTINUE, ContinueValue(), pos);
         }
         else if (typeIs(TT_IF))
             return if_statement();
@@ -172,8 +205,7 @@ namespace snowlang::parser
             auto expression = expr();
             accept(TT_SEMICOLON, err::EXPECTED_SEMICOLON);
             pos.end = accepted().pos.end;
-            return make_unique<Node>(
-                NT_RETURN, ReturnValue(move(expression)), pos);
+            return m_ast.add(NT_RETURN, ReturnValue{expression}, pos);
         }
         else if (typeIs(TT_PRINT))
             return print();
@@ -192,7 +224,7 @@ namespace snowlang::parser
                 current().pos, err::EXPECTED_FIRST_OF_INSTRUCTION);
     }
 
-    std::unique_ptr<Node> Parser::construct()
+    NodeId Parser::construct()
     {
         Pos pos(fileIndex);
         accept(TT_LET, err::EXPECTED_LET);
@@ -200,28 +232,29 @@ namespace snowlang::parser
 
         // Parse typename
         accept(TT_IDEN, err::EXPECTED_IDEN);
-        Token typeName = accepted();
+        auto typeName = keepAccepted();
 
         // Parse arguments for construction
-        vector<unique_ptr<Node>> args;
+        size_t args = m_children.size();
         if (accept(TT_LPAREN))
         {
             if (!accept(TT_RPAREN))
             {
                 do
                 {
-                    args.push_back(assign());
+                    m_children.push_back(assign());
                 } while (accept(TT_COMMA));
                 accept(TT_RPAREN, err::EXPECTED_RPAREN);
             }
         }
+        NodeList argList = endList(args);
 
         // Parse identifier
         accept(TT_IDEN, err::EXPECTED_IDEN);
-        auto identidier = accepted();
+        auto identidier = keepAccepted();
 
         // Parse array size specifier
-        unique_ptr<Node> arraySize = nullptr;
+        NodeId arraySize = 0;
         if (accept(TT_LBRACK)) // Optional - type is array
         {
             arraySize = expr();
@@ -231,14 +264,13 @@ namespace snowlang::parser
         accept(TT_SEMICOLON, err::EXPECTED_SEMICOLON);
         pos.end = accepted().pos.end;
 
-        return make_unique<Node>(
+        return m_ast.add(
             NT_DEFINE,
-            DefineValue(
-                typeName, move(arraySize), move(args), identidier),
+            DefineValue{typeName, arraySize, argList, identidier},
             pos);
     }
 
-    std::unique_ptr<Node> Parser::connect()
+    NodeId Parser::connect()
     {
         Pos pos(fileIndex);
         accept(TT_CON, err::EXPECTED_CON);
@@ -248,19 +280,17 @@ namespace snowlang::parser
         auto right = item();
         accept(TT_SEMICOLON, err::EXPECTED_SEMICOLON);
         pos.end = accepted().pos.end;
-        return make_unique<Node>(
-            NT_CON,
-            ConValue(move(left), move(right)), pos);
+        return m_ast.add(NT_CON, ConValue{left, right}, pos);
     }
 
-    std::unique_ptr<Node> Parser::for_loop()
+    NodeId Parser::for_loop()
     {
         Pos pos(fileIndex);
         accept(TT_FOR, err::EXPECTED_FOR);
         pos.start = accepted().pos.start;
 
         accept(TT_IDEN, err::EXPECTED_IDEN);
-        auto var = accepted();
+        auto var = keepAccepted();
         accept(TT_IN, err::EXPECTED_IN);
         accept(TT_LPAREN, err::EXPECTED_LPAREN);
         auto from = expr();
@@ -271,12 +301,11 @@ namespace snowlang::parser
         auto blockNode = block();
         accept(TT_RBRACE, err::EXPECTED_RBRACE);
         pos.end = accepted().pos.end;
-        return make_unique<Node>(
-            NT_FOR,
-            ForValue(var, move(from), move(to), move(blockNode)), pos);
+        return m_ast.add(
+            NT_FOR, ForValue{var, from, to, blockNode}, pos);
     }
 
-    std::unique_ptr<Node> Parser::while_loop()
+    NodeId Parser::while_loop()
     {
         Pos pos(fileIndex);
         accept(TT_WHILE, err::EXPECTED_WHILE);
@@ -287,39 +316,46 @@ namespace snowlang::parser
         auto blockNode = block();
         accept(TT_RBRACE, err::EXPECTED_RBRACE);
         pos.end = accepted().pos.end;
-        return make_unique<Node>(
-            NT_WHILE,
-            WhileValue(move(cond), move(blockNode)), pos);
+        return m_ast.add(NT_WHILE, WhileValue{cond, blockNode}, pos);
     }
 
-    std::unique_ptr<Node> Parser::if_statement()
+    NodeId Parser::if_statement()
     {
         Pos pos(fileIndex);
         accept(TT_IF, err::EXPECTED_IF);
         pos.start = accepted().pos.start;
 
-        vector<unique_ptr<Node>> conds;
-        vector<unique_ptr<Node>> ifBlocks;
+        // conditions and blocks alternate until the else block
+        size_t branches = m_children.size();
         do
         {
-            conds.push_back(expr());
+            m_children.push_back(expr());
             accept(TT_LBRACE, err::EXPECTED_LBRACE);
-            ifBlocks.push_back(block());
+            m_children.push_back(block());
             accept(TT_RBRACE, err::EXPECTED_RBRACE);
         } while (accept(TT_ELIF));
         if (accept(TT_ELSE))
         {
             accept(TT_LBRACE, err::EXPECTED_LBRACE);
-            ifBlocks.push_back(block());
+            m_children.push_back(block());
             accept(TT_RBRACE, err::EXPECTED_RBRACE);
         }
         pos.end = accepted().pos.end;
-        return make_unique<Node>(
-            NT_IF,
-            IfValue(move(conds), move(ifBlocks)), pos);
+
+        size_t end = m_children.size();
+        for (size_t i = branches; i + 1 < end; i += 2)
+            m_children.push_back(m_children[i]);
+        NodeList conds = endList(end);
+        for (size_t i = branches + 1; i < end; i += 2)
+            m_children.push_back(m_children[i]);
+        if ((end - branches) % 2) // else block
+            m_children.push_back(m_children[end - 1]);
+        NodeList ifBlocks = endList(end);
+        m_children.resize(branches);
+        return m_ast.add(NT_IF, IfValue{conds, ifBlocks}, pos);
     }
 
-    std::unique_ptr<Node> Parser::print()
+    NodeId Parser::print()
     {
         Pos pos(fileIndex);
         accept(TT_PRINT, err::EXPECTED_PRINT);
@@ -327,24 +363,27 @@ namespace snowlang::parser
 
         if (accept(TT_STRLIT))
         {
-            auto strlit = accepted();
-            vector<unique_ptr<Node>> expresions;
+            auto strlit = keepAccepted();
+            size_t expresions = m_children.size();
             while (accept(TT_COMMA))
-                expresions.push_back(expr());
+                m_children.push_back(expr());
             accept(TT_SEMICOLON, err::EXPECTED_SEMICOLON);
             pos.end = accepted().pos.end;
-            return make_unique<Node>(
-                NT_PRINT, PrintValue(strlit, move(expresions)), pos);
+            return m_ast.add(
+                NT_PRINT,
+                PrintValue{strlit, endList(expresions), 0, 0}, pos);
         }
         auto itemToPrint = item();
+        NodeId lane = 0;
+        if (accept(TT_IN)) // Optional lane
+            lane = expr();
         accept(TT_SEMICOLON, err::EXPECTED_SEMICOLON);
         pos.end = accepted().pos.end;
-        return make_unique<Node>(
-            NT_PRINT,
-            PrintValue(move(itemToPrint)), pos);
+        return m_ast.add(
+            NT_PRINT, PrintValue{0, NodeList(), itemToPrint, lane}, pos);
     }
 
-    std::unique_ptr<Node> Parser::tick()
+    NodeId Parser::tick()
     {
         Pos pos(fileIndex);
         accept(TT_TICK, err::EXPECTED_TICK);
@@ -353,11 +392,10 @@ namespace snowlang::parser
         auto expression = expr();
         accept(TT_SEMICOLON, err::EXPECTED_SEMICOLON);
         pos.end = accepted().pos.end;
-        return make_unique<Node>(
-            NT_TICK, TickValue(move(expression)), pos);
+        return m_ast.add(NT_TICK, TickValue{expression}, pos);
     }
 
-    std::unique_ptr<Node> Parser::hold()
+    NodeId Parser::hold()
     {
         Pos pos(fileIndex);
         accept(TT_HOLD, err::EXPECTED_HOLD);
@@ -365,151 +403,136 @@ namespace snowlang::parser
 
         auto itemNode = item();
         accept(TT_INT, err::EXPECTED_INT);
-        auto holdAs = accepted();
+        auto holdAs = keepAccepted();
         auto holdFor = expr();
+        NodeId lane = 0;
+        if (accept(TT_IN)) // Optional lane
+            lane = expr();
         accept(TT_SEMICOLON, err::EXPECTED_SEMICOLON);
         pos.end = accepted().pos.end;
-        return make_unique<Node>(
-            NT_HOLD, HoldValue(move(itemNode), move(holdFor), holdAs),
-            pos);
+        return m_ast.add(
+            NT_HOLD, HoldValue{itemNode, holdFor, holdAs, lane}, pos);
     }
 
-    std::unique_ptr<Node> Parser::assign()
+    NodeId Parser::assign()
     {
         Pos pos(fileIndex);
 
         auto lhs = expr();
-        pos.start = lhs->pos.start;
+        pos.start = posOf(lhs).start;
         if (accept(TT_ASSIGN))
         {
             auto rhs = expr();
-            pos.end = rhs->pos.end;
+            pos.end = posOf(rhs).end;
             // make sure lhs is just an identifier
-            return make_unique<Node>(
-                NT_VARASSIGN,
-                VarAssignValue(move(lhs), move(rhs)), pos);
+            return m_ast.add(NT_VARASSIGN, VarAssignValue{lhs, rhs}, pos);
         }
-        pos.end = lhs->pos.end;
-        return make_unique<Node>(
-            NT_VARASSIGN,
-            VarAssignValue(nullptr, move(lhs)), pos);
+        pos.end = posOf(lhs).end;
+        return m_ast.add(NT_VARASSIGN, VarAssignValue{0, lhs}, pos);
     }
 
-    unique_ptr<Node> Parser::item()
+    NodeId Parser::item()
     {
         accept(TT_IDEN, err::EXPECTED_IDEN);
         int posStart = accepted().pos.start;
-        auto identifier = accepted();
-        unique_ptr<Node> index = nullptr;
+        auto identifier = keepAccepted();
+        NodeId index = 0;
         if (accept(TT_LBRACK)) // Optional indexing
         {
             index = expr();
             accept(TT_RBRACK, err::EXPECTED_RBRACK);
         }
-        unique_ptr<Node> next = nullptr;
+        NodeId next = 0;
         int posEnd = accepted().pos.end;
         if (accept(TT_PERIOD)) // Optional member access
         {
             next = item();
-            posEnd = next->pos.end;
+            posEnd = posOf(next).end;
         }
-        return make_unique<Node>(
+        return m_ast.add(
             NT_ITEM,
-            ItemValue(identifier, move(index), move(next)),
+            ItemValue{identifier, index, next},
             Pos(posStart, posEnd, fileIndex));
     }
 
-    unique_ptr<Node> Parser::expr()
-    {
-        return parseBinOp({TT_AND}, [this]()
-                          { return this->orExpr(); });
-    }
-
-    unique_ptr<Node> Parser::orExpr()
-    {
-        return parseBinOp({TT_OR}, [this]()
-                          { return this->equalityExpr(); });
-    }
-
-    unique_ptr<Node> Parser::equalityExpr()
-    {
-        return parseBinOp({TT_EQ, TT_NEQ}, [this]()
-                          { return this->inequalityExpr(); });
-    }
-
-    unique_ptr<Node> Parser::inequalityExpr()
-    {
-        return parseBinOp({TT_GT, TT_GE, TT_LE, TT_LT}, [this]()
-                          { return this->arithExpr(); });
-    }
-
-    unique_ptr<Node> Parser::arithExpr()
+    NodeId Parser::expr()
     {
-        return parseBinOp({TT_PLUS, TT_MINUS}, [this]()
-                          { return this->term(); });
+        return binaryExpr(PREC_AND);
     }
 
-    unique_ptr<Node> Parser::term()
+    NodeId Parser::binaryExpr(int minPrecedence)
     {
-        return parseBinOp({TT_MULT, TT_DIV, TT_REM}, [this]()
-                          { return this->factor(); });
+        auto left = unaryExpr();
+        while (true)
+        {
+            int precedence = PRECEDENCES[current().type];
+            if (precedence < minPrecedence) // also if it's no operator
+                return left;
+            auto operation = current().type;
+            advance();
+            // `**` is right associative and takes unary operations
+            // on the right
+            auto right = binaryExpr(
+                operation == TT_POW ? precedence : precedence + 1);
+            left = m_ast.add(
+                NT_BINOP,
+                BinOpValue{left, right, operation},
+                Pos(posOf(left).start, posOf(right).end, fileIndex));
+        }
     }
 
-    unique_ptr<Node> Parser::factor()
+    NodeId Parser::unaryExpr()
     {
-        if (accept({TT_PLUS, TT_MINUS, TT_NOT}))
+        if (accept(UNARY_OPERATORS))
         {
-            auto operationToken = accepted();
+            auto operation = accepted().type;
             int posStart = accepted().pos.start;
-            auto node = factor();
-            int posEnd = node->pos.end;
-            return make_unique<Node>(
+            // binds less tightly than `**`
+            auto node = binaryExpr(PREC_POW);
+            int posEnd = posOf(node).end;
+            return m_ast.add(
                 NT_UNOP,
-                UnOpValue(move(node), operationToken),
+                UnOpValue{node, operation},
                 Pos(posStart, posEnd, fileIndex));
         }
-        return parseBinOp(
-            {TT_POW}, [this]()
-            { return this->atom(); },
-            [this]()
-            { return this->factor(); });
+        return atom();
     }
 
-    unique_ptr<Node> Parser::atom()
+    NodeId Parser::atom()
     {
         if (accept({TT_FLOAT, TT_INT}))
         {
-            return make_unique<Node>(
-                NT_LEAF, LeafValue(accepted()),
+            return m_ast.add(
+                NT_LEAF, LeafValue{keepAccepted()},
                 Pos(accepted().pos.start,
                     accepted().pos.end,
                     fileIndex));
         }
         else if (accept(TT_IDEN))
         {
-            auto identifier = accepted();
+            auto identifier = keepAccepted();
             int posStart = accepted().pos.start;
             int posEnd = accepted().pos.end;
             if (accept(TT_LPAREN)) // is function call
             {
-                vector<unique_ptr<Node>> args;
+                size_t args = m_children.size();
                 if (!accept(TT_RPAREN))
                 {
                     do
                     {
-                        args.push_back(assign());
+                        m_children.push_back(assign());
                     } while (accept(TT_COMMA));
                     accept(TT_RPAREN, err::EXPECTED_RPAREN);
                 }
                 posEnd = accepted().pos.end;
-                return make_unique<Node>(
+                return m_ast.add(
                     NT_FUNCCALL,
-                    FuncCallValue(identifier, move(args)),
+                    FuncCallValue{identifier, endList(args)},
                     Pos(posStart, posEnd, fileIndex));
             }
             else // is variable
-                return make_unique<Node>(
-                    NT_LEAF, LeafValue(identifier),
+                return m_ast.add(
+                    NT_LEAF, LeafValue{identifier},
                     Pos(posStart, posEnd, fileIndex));
         }
         accept(TT_LPAREN, err::EXPECTED_FIRST_OF_ATOM);
@@ -518,43 +541,21 @@ namespace snowlang::parser
         return node;
     }
 
-    unique_ptr<Node> Parser::parseBinOp(
-        unordered_set<TokenType> types,
-        function<unique_ptr<Node>()> funcLeft,
-        function<unique_ptr<Node>()> funcRight)
-    {
-        if (!funcRight)
-            funcRight = funcLeft;
-
-        auto left = funcLeft();
-
-        while (accept(types))
-        {
-            auto operationToken = accepted();
-            auto right = funcRight();
-            left = make_unique<Node>(
-                NT_BINOP,
-                BinOpValue(move(left), move(right), operationToken),
-                Pos(left->pos.start, right->pos.end, fileIndex));
-        }
-        return left;
-    }
-
-    unique_ptr<Node> Parser::parse()
+    Ast Parser::parse()
     {
-        auto res = script();
-        if (pos < tokens.size() - 1)
+        m_ast.root = script();
+        if (!typeIs(TT_EOF))
             throw err::LexerParserException(
                 current().pos, err::EXPECTED_EOI);
-        return res;
+        return std::move(m_ast);
     }
 
-    unique_ptr<Node> Parser::parseInstruction()
+    Ast Parser::parseInstruction()
     {
-        auto res = instruction();
-        if (pos < tokens.size() - 1)
+        m_ast.root = instruction();
+        if (!typeIs(TT_EOF))
             throw err::LexerParserException(
                 current().pos, err::EXPECTED_EOI);
-        return res;
+        return std::move(m_ast);
     }
 }
@@ -1,80 +1,115 @@
 #pragma once
 
-#include <unordered_set>
+#include <cstdint>
+#include <initializer_list>
 #include "node.hpp"
+#include "lexer.hpp"
 #include "errorHandler.hpp"
 
 namespace snowlang::parser
 {
-    const std::unordered_set<TokenType> FIRST_OF_EXPR =
+    // set of token types (one bit per type)
+    struct TokenSet
+    {
+        uint64_t bits{0};
+
+        constexpr TokenSet(std::initializer_list<TokenType> types)
+        {
+            for (TokenType type : types)
+                bits |= uint64_t(1) << type;
+        }
+        constexpr bool contains(TokenType type) const
+        {
+            return (bits >> type) & 1;
+        }
+    };
+    static_assert(TT_STRLIT < 64, "token types must fit in a TokenSet");
+
+    constexpr TokenSet FIRST_OF_EXPR =
         {TT_INT, TT_FLOAT, TT_IDEN, TT_PLUS, TT_MINUS, TT_LPAREN};
+    constexpr TokenSet FIRST_OF_INSTRUCTION =
+        {TT_LET, TT_CON, TT_FOR, TT_WHILE, TT_BREAK, TT_CONTINUE, TT_IF,
+         TT_RETURN, TT_PRINT, TT_TICK, TT_HOLD};
 
     struct Parser
     {
-        const std::vector<Token> &tokens;
-        size_t pos = 0;
+        // tokens are taken from the stream as they're parsed
+        lexer::Lexer &tokens;
 
-        Parser(const std::vector<Token> &t_tokens, size_t t_fileIndex = 0)
+        Parser(lexer::Lexer &t_tokens, size_t t_fileIndex = 0)
             : tokens(t_tokens), fileIndex(t_fileIndex) {}
 
-        std::unique_ptr<Node> parse();
-        std::unique_ptr<Node> parseInstruction();
+        Ast parse();
+        Ast parseInstruction();
 
     private:
         size_t fileIndex;
 
+        // tree being built
+        Ast m_ast;
+        // children of the lists being parsed (innermost last)
+        std::vector<NodeId> m_children;
+
+        // token last accepted (a copy, as the stream moves on)
         Token m_acceptedToken;
 
-        inline Token current() { return tokens[pos]; }
+        inline const Token &current() { return tokens.current(); }
 
-        inline void advance(int positions = 1) { pos += positions; }
+        inline void advance() { tokens.next(); }
 
         inline bool accept(
             TokenType type,
             const std::string &errorMessage = err::NOERR);
         inline bool accept(
-            std::unordered_set<TokenType> types,
+            TokenSet types,
             const std::string &errorMessage = err::NOERR);
 
         inline bool typeIs(TokenType type)
         {
             return current().type == type;
         }
-        inline bool typeIs(std::unordered_set<TokenType> types)
+        inline bool typeIs(TokenSet types)
         {
-            return types.count(current().type) > 0;
+            return types.contains(current().type);
         }
 
-        inline Token accepted()
+        inline const Token &accepted()
         {
             return m_acceptedToken;
         }
-        std::unique_ptr<Node> script();
-        std::unique_ptr<Node> block();
-        std::unique_ptr<Node> instruction();
-        std::unique_ptr<Node> construct();
-        std::unique_ptr<Node> connect();
-        std::unique_ptr<Node> for_loop();
-        std::unique_ptr<Node> while_loop();
-        std::unique_ptr<Node> if_statement();
-        std::unique_ptr<Node> print();
-        std::unique_ptr<Node> tick();
-        std::unique_ptr<Node> hold();
-        std::unique_ptr<Node> assign();
-        std::unique_ptr<Node> item();
-        std::unique_ptr<Node> expr();
-        std::unique_ptr<Node> orExpr();
-        std::unique_ptr<Node> equalityExpr();
-        std::unique_ptr<Node> inequalityExpr();
-        std::unique_ptr<Node> arithExpr();
-        std::unique_ptr<Node> term();
-        std::unique_ptr<Node> factor();
-        std::unique_ptr<Node> atom();
-
-        std::unique_ptr<Node> parseBinOp(
-            std::unordered_set<TokenType> types,
-            std::function<std::unique_ptr<Node>()> funcLeft,
-            std::function<std::unique_ptr<Node>()> funcRight = nullptr);
+        // keeps the token last accepted in the tree
+        inline TokenId keepAccepted()
+        {
+            return m_ast.add(m_acceptedToken);
+        }
+        // position of node `id`
+        inline const Pos &posOf(NodeId id) { return m_ast.nodes[id].pos; }
+        // moves the children pushed since `from` into a list of the tree
+        inline NodeList endList(size_t from)
+        {
+            NodeList list = m_ast.list(m_children, from);
+            m_children.resize(from);
+            return list;
+        }
+        NodeId script();
+        NodeId block();
+        NodeId instruction();
+        NodeId construct();
+        NodeId connect();
+        NodeId for_loop();
+        NodeId while_loop();
+        NodeId if_statement();
+        NodeId print();
+        NodeId tick();
+        NodeId hold();
+        NodeId assign();
+        NodeId item();
+        NodeId expr();
+        // expression whose binary operators bind at least as tightly as
+        // `minPrecedence` (precedence climbing, see PRECEDENCES)
+        NodeId binaryExpr(int minPrecedence);
+        // operand of a binary operator (unary operation or atom)
+        NodeId unaryExpr();
+        NodeId atom();
     };
-    std::unique_ptr<Node> parse(const std::vector<Token> &tokens);
 }
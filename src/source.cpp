@@ -0,0 +1,57 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source.hpp"
+
+namespace snowlang
+{
+    Source::Source(std::string t_text)
+        : m_buffer(std::move(t_text))
+    {
+        m_text = m_buffer;
+    }
+
+    Source::~Source()
+    {
+        if (m_mapping)
+            munmap(m_mapping, m_mappingLength);
+    }
+
+    std::shared_ptr<const Source> Source::load(const std::string &filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+        std::shared_ptr<Source> source(new Source());
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) &&
+            info.st_size > 0)
+        {
+            void *mapping = mmap(
+                nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                close(fd);
+                source->m_mapping = mapping;
+                source->m_mappingLength = info.st_size;
+                source->m_text = std::string_view(
+                    (const char *)mapping, info.st_size);
+                return source;
+            }
+        }
+
+        // (empty files, files that can't be mapped such as pipes, or if
+        // mapping failed)
+        char buf[64 * 1024];
+        ssize_t length;
+        while ((length = read(fd, buf, sizeof(buf))) > 0)
+            source->m_buffer.append(buf, length);
+        close(fd);
+        if (length < 0)
+            return nullptr;
+        source->m_text = source->m_buffer;
+        return source;
+    }
+}
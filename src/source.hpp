@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+
+namespace snowlang
+{
+    // Text of a source file.
+    // Files are mapped into memory where possible (else read), so the
+    // text is never copied; the lexer, the tokens and error messages all
+    // refer to it. Sources are shared by everything that may report an
+    // error in them and live until the last of those is gone.
+    class Source
+    {
+    public:
+        // text that isn't in a file (such as console input)
+        explicit Source(std::string t_text);
+        ~Source();
+
+        Source(const Source &) = delete;
+        Source &operator=(const Source &) = delete;
+
+        // nullptr if the file can't be opened or read
+        static std::shared_ptr<const Source> load(
+            const std::string &filename);
+
+        inline std::string_view text() const
+        {
+            return m_text;
+        }
+
+    private:
+        Source() = default;
+
+        std::string_view m_text;
+        // mapping of the file (nullptr if m_text is in m_buffer)
+        void *m_mapping{nullptr};
+        size_t m_mappingLength{0};
+        std::string m_buffer;
+    };
+}
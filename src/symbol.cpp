@@ -171,41 +171,35 @@ namespace snowlang
             return std::to_string(getFloat());
     }
 
-    std::string SymbolTable::setSymbol(
-        const std::string &name, SymbolValueType value)
+    std::string SymbolTable::setSymbol(Name name, SymbolValueType value)
     {
-        SymbolTable *symbolTable = this;
-        auto mapToUpdate = &m_symbols;
-
         // Get the closest symbolTable with a symbol with the given name
-        while (symbolTable)
-        {
-            if (symbolTable->m_symbols.count(name) > 0)
-            {
-                mapToUpdate = &symbolTable->m_symbols;
-                break;
-            }
-            symbolTable = symbolTable->parent;
-        }
-        // Make sure that symbol is modifiable
-        if ((*mapToUpdate).count(name) > 0)
+        for (SymbolTable *symbolTable = this; symbolTable;
+             symbolTable = symbolTable->parent)
         {
-            auto &value = (*mapToUpdate)[name];
-            if (std::holds_alternative<ModuleDeclaration>(value) ||
-                std::holds_alternative<FunctionDeclaration>(value))
-                return err::REDECL(name);
+            auto it = symbolTable->m_symbols.find(name);
+            if (it == symbolTable->m_symbols.end())
+                continue;
+            // Make sure that symbol is modifiable
+            if (std::holds_alternative<ModuleDeclaration>(it->second) ||
+                std::holds_alternative<FunctionDeclaration>(it->second))
+                return err::REDECL(name.str());
+            it->second = std::move(value);
+            return err::NOERR;
         }
-        (*mapToUpdate)[name] = std::move(value);
+        m_symbols.emplace(name, std::move(value));
         return err::NOERR;
     }
 
-    SymbolValueType *SymbolTable::lookup(const std::string &name)
+    SymbolValueType *SymbolTable::lookup(Name name)
     {
-        for (auto &entry : m_symbols)
-            if (entry.first == name)  // names match
-                return &entry.second; // return assigned value
-        if (parent)
-            return parent->lookup(name);
+        for (SymbolTable *symbolTable = this; symbolTable;
+             symbolTable = symbolTable->parent)
+        {
+            auto it = symbolTable->m_symbols.find(name);
+            if (it != symbolTable->m_symbols.end())
+                return &it->second;
+        }
         return nullptr;
     }
 
@@ -216,4 +210,12 @@ namespace snowlang
             table = table->parent;
         return table;
     }
+
+    size_t SymbolTable::numSymbols()
+    {
+        size_t count = 0;
+        for (SymbolTable *table = this; table; table = table->parent)
+            count += table->m_symbols.size();
+        return count;
+    }
 }
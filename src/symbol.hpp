@@ -6,6 +6,11 @@
 #include "node.hpp"
 #include "errorHandler.hpp"
 
+namespace snowlang::bytecode
+{
+    struct Code;
+}
+
 namespace snowlang
 {
     struct Number
@@ -68,28 +73,32 @@ namespace snowlang
     // for dealing with argument lists
     struct Args
     {
-        std::vector<std::string> argNames;
-        std::unordered_map<std::string, Number> defaultArgs;
+        std::vector<Name> argNames;
+        // default arguments in order of declaration
+        std::vector<Name> defaultNames;
+        std::vector<Number> defaultValues;
     };
 
     struct ModuleDeclaration
     {
         Args args;
-        std::unique_ptr<Node> body;
+        // compiled body (owned by the code that declared it)
+        const bytecode::Code *body;
 
         ModuleDeclaration(
-            const Args &t_args, std::unique_ptr<Node> t_body)
-            : args(t_args), body(std::move(t_body)) {}
+            const Args &t_args, const bytecode::Code *t_body)
+            : args(t_args), body(t_body) {}
     };
 
     struct FunctionDeclaration
     {
         Args args;
-        std::unique_ptr<Node> body;
+        // compiled body (owned by the code that declared it)
+        const bytecode::Code *body;
 
         FunctionDeclaration(
-            const Args &t_args, std::unique_ptr<Node> t_body)
-            : args(t_args), body(std::move(t_body)) {}
+            const Args &t_args, const bytecode::Code *t_body)
+            : args(t_args), body(t_body) {}
     };
 
     using SymbolValueType = std::variant<
@@ -105,14 +114,14 @@ namespace snowlang
         SymbolTable() = default;
 
         // returns error or err::NOERR if there's no error
-        std::string setSymbol(
-            const std::string &name, SymbolValueType value);
-        SymbolValueType *lookup(const std::string &name);
+        std::string setSymbol(Name name, SymbolValueType value);
+        SymbolValueType *lookup(Name name);
         SymbolTable *firstAncestor();
+        // number of symbols in this table and its ancestors
+        size_t numSymbols();
 
     private:
-        std::unordered_map<std::string, SymbolValueType>
-            m_symbols;
+        std::unordered_map<Name, SymbolValueType> m_symbols;
         SymbolTable *parent{nullptr};
     };
 }
\ No newline at end of file
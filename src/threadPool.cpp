@@ -0,0 +1,78 @@
+#include <atomic>
+#include "threadPool.hpp"
+
+namespace snowlang
+{
+    ThreadPool::ThreadPool(size_t numThreads)
+    {
+        for (size_t i = 1; i < numThreads; i++)
+            m_workers.emplace_back(&ThreadPool::work, this, i);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_start.notify_all();
+        for (auto &worker : m_workers)
+            worker.join();
+    }
+
+    void ThreadPool::run(const std::function<void(size_t)> &task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_task = &task;
+            m_remaining = m_workers.size();
+            m_generation++;
+        }
+        m_start.notify_all();
+
+        task(0);
+
+        // wait for all workers (barrier)
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]()
+                    { return m_remaining == 0; });
+        m_task = nullptr;
+    }
+
+    void ThreadPool::runTasks(
+        size_t numTasks, const std::function<void(size_t)> &task)
+    {
+        std::atomic<size_t> next{0};
+        run([&](size_t)
+            {
+                for (size_t i = next++; i < numTasks; i = next++)
+                    task(i);
+            });
+    }
+
+    void ThreadPool::work(size_t index)
+    {
+        size_t generation = 0;
+        while (true)
+        {
+            const std::function<void(size_t)> *task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start.wait(lock, [this, generation]()
+                             { return m_stopping ||
+                                      m_generation != generation; });
+                if (m_stopping)
+                    return;
+                generation = m_generation;
+                task = m_task;
+            }
+
+            (*task)(index);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_remaining--;
+            if (m_remaining == 0)
+                m_done.notify_one();
+        }
+    }
+}
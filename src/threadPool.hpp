@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace snowlang
+{
+    // Fixed set of worker threads that run the same task in parallel.
+    class ThreadPool
+    {
+    public:
+        // numThreads includes the calling thread
+        explicit ThreadPool(size_t numThreads);
+        ~ThreadPool();
+
+        inline size_t size() const
+        {
+            return m_workers.size() + 1;
+        }
+
+        // runs task(i) for every i in [0, size()) in parallel and returns
+        // once all of them have finished. task(0) runs on the calling thread.
+        void run(const std::function<void(size_t)> &task);
+        // runs task(i) for every i in [0, numTasks) in parallel and returns
+        // once all of them have finished. each thread takes the next task
+        // nobody has taken yet, so tasks of uneven length are balanced.
+        void runTasks(size_t numTasks,
+                      const std::function<void(size_t)> &task);
+
+    private:
+        std::vector<std::thread> m_workers;
+        std::mutex m_mutex;
+        std::condition_variable m_start;
+        std::condition_variable m_done;
+
+        const std::function<void(size_t)> *m_task = nullptr;
+        size_t m_generation = 0; // incremented for every task
+        size_t m_remaining = 0;  // workers still running the task
+        bool m_stopping = false;
+
+        void work(size_t index);
+    };
+}
@@ -2,8 +2,10 @@
 
 #include <iostream>
 #include <regex>
+#include <string_view>
 
 #include "pos.hpp"
+#include "name.hpp"
 
 namespace snowlang
 {
@@ -61,7 +63,11 @@ namespace snowlang
   struct Token
   {
     enum TokenType type = TT_NULL;
-    std::string value;
+    // text of numbers and string literals
+    // (in the source text, which outlives the token)
+    std::string_view value;
+    // identifiers are interned
+    Name name;
     Pos pos;
 
     ////////////////////////
@@ -73,7 +79,11 @@ namespace snowlang
 
     // initializes token with given type, position and value (default empty)
     Token(enum TokenType t_type,
-          const Pos &t_pos, const std::string &t_value = std::string())
+          const Pos &t_pos, std::string_view t_value = std::string_view())
         : type(t_type), value(t_value), pos(t_pos) {}
+
+    // initializes identifier token with given position and name
+    Token(const Pos &t_pos, Name t_name)
+        : type(TT_IDEN), name(t_name), pos(t_pos) {}
   };
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+# Runs the regression programs (*.sno) and compares what they print with
+# the expected output (*.out), in every simulation mode with one and with
+# four threads, and without reusing function results (the programs print
+# the same in every case). Programs without a runtime function read their
+# console input from *.in.
+cd "$(dirname "$0")"
+failed=0
+check() {
+    local program="$1"
+    shift
+    local input="${program%.sno}.in"
+    [ -f "$input" ] || input=/dev/null
+    if ! ../snowlang "$@" "$program" < "$input" 2>&1 |
+        cmp -s - "${program%.sno}.out"; then
+        echo "FAILED: $program ($*)"
+        failed=1
+    fi
+}
+for program in *.sno; do
+    for sim in sweep event word batch jit settle; do
+        for threads in 1 4; do
+            check "$program" --sim=$sim --threads=$threads
+        done
+    done
+    check "$program" --no-cache
+    check "$program" --no-cache --threads=4
+done
+
+# large files are lexed in chunks of lines on several threads, which
+# mustn't split strings continued over lines with `\`
+large=$(mktemp)
+{
+    echo 'mod Main { let and a; }'
+    echo 'let runtime ()'
+    echo '{'
+    for i in $(seq 8000); do
+        printf '    print "line %d \\\n    continued\\n";\n' $i
+        printf '    # comment ending in a backslash \\\n'
+    done
+    echo '}'
+} > "$large"
+if ! cmp -s <(../snowlang --threads=1 "$large" 2>&1) \
+    <(../snowlang --threads=4 "$large" 2>&1); then
+    echo "FAILED: strings continued over lines (--threads=4)"
+    failed=1
+fi
+rm -f "$large"
+
+if [ $failed = 0 ]; then
+    echo "ALL PASSED"
+fi
+exit $failed